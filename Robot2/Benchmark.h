@@ -62,6 +62,12 @@ void ProxyTest()
 #include <iomanip>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cmath>
 
 template<size_t N>
 struct StringLiteral {
@@ -138,12 +144,15 @@ class BenchmarkT;
 
 class BenchmarkTCollector
 {
-    inline static std::vector<std::tuple<const char*, int, const char*(*)(int), std::reference_wrapper<std::chrono::microseconds>, std::reference_wrapper<size_t>>> benchmarks;
+    // The probes run on several threads (config loader, detection pool, renderer): the counters are atomic and the list is guarded.
+    inline static std::vector<std::tuple<const char*, int, const char*(*)(int), std::atomic<long long>*, std::atomic<size_t>*>> benchmarks;
+    inline static std::mutex benchmarksMutex;
 public:
     enum class SortBy {Name, Time, Count};
 
     static void Print(SortBy sortMode = SortBy::Time)
     {
+        std::lock_guard<std::mutex> lock(benchmarksMutex);
         // Sort result.
         std::sort(benchmarks.begin(), benchmarks.end(), [sortMode](const auto& a, const auto& b)->bool {
             if (sortMode == SortBy::Name) {
@@ -156,10 +165,10 @@ public:
                 }
                 return std::get<1>(a) > std::get<1>(b); // Compare subtypes.
             }
-            if (sortMode == SortBy::Time || sortMode == SortBy::Count && std::get<4>(a) == std::get<4>(b)) {
-                return std::get<3>(a).get().count() > std::get<3>(b).get().count(); // Compare times.
+            if (sortMode == SortBy::Time || sortMode == SortBy::Count && std::get<4>(a)->load() == std::get<4>(b)->load()) {
+                return std::get<3>(a)->load() > std::get<3>(b)->load(); // Compare times.
             }
-            return std::get<4>(a).get() > std::get<4>(b).get(); // Compare call count.
+            return std::get<4>(a)->load() > std::get<4>(b)->load(); // Compare call count.
             });
 
         // Calculate padding based on the longest entry's title's length.
@@ -187,8 +196,8 @@ public:
             const char* title = std::get<0>(elem);
             int subtype = std::get<1>(elem);
             const char* (*typeToStringFunc)(int) = std::get<2>(elem);
-            std::chrono::microseconds& totalTime = std::get<3>(elem).get();
-            size_t& totalCalls = std::get<4>(elem).get();
+            const long long totalTimeUs = std::get<3>(elem)->load();
+            const size_t totalCalls = std::get<4>(elem)->load();
 
             if (typeToStringFunc) {
                 const char* typeStr = typeToStringFunc(subtype);
@@ -204,7 +213,7 @@ public:
             }
             std::cout << ":" << std::setfill(' ') << std::setw(5) << totalCalls << "x ";
 
-            long long ticks = totalTime.count(); const char* unit = "u"; int divs = 0; int fraction = 0;
+            long long ticks = totalTimeUs; const char* unit = "u"; int divs = 0; int fraction = 0;
             if (ticks > 1000) { fraction = ticks % 1000; ticks /= 1000; divs++; unit = "m"; }
             if (ticks > 1000) { fraction = ticks % 1000; ticks /= 1000; divs++; unit = ""; }
             std::cout << std::setfill(' ') << std::setw(10-divs*4) << ticks;
@@ -214,45 +223,42 @@ public:
     }
     static std::map<std::string, std::tuple<long long, size_t>> Results()
     {
+        std::lock_guard<std::mutex> lock(benchmarksMutex);
         std::map<std::string, std::tuple<long long, size_t>> result;
         for (auto const& elem : benchmarks)
         {
             const char* title = std::get<0>(elem);
             int subtype = std::get<1>(elem);
             const char* (*typeToStringFunc)(int) = std::get<2>(elem);
-            std::chrono::microseconds& totalTime = std::get<3>(elem).get();
-            size_t& totalCalls = std::get<4>(elem).get();
 
             std::stringstream titleStr;
             titleStr << title;
 
             if (typeToStringFunc) {
                 const char* typeStr = typeToStringFunc(subtype);
-                int titleLen = 1 + strlen(typeStr);
                 titleStr << '-' << typeStr;
             }
             else if (subtype) {
-                int titleLen = 1 + log10(subtype) + 1;
                 titleStr << '.' << subtype;
             }
-            result.emplace(std::make_pair<std::string, std::tuple<long long, size_t>>(titleStr.str(), { totalTime.count(), totalCalls }));
+            result.emplace(std::make_pair<std::string, std::tuple<long long, size_t>>(titleStr.str(), { std::get<3>(elem)->load(), std::get<4>(elem)->load() }));
         }
         return result;
     }
 
-    static void Add(char const* title, int subtype, const char* typeToStringFunc(int), std::chrono::microseconds& totalTimeRef, size_t& totalCallsRef)
+    static void Add(char const* title, int subtype, const char* typeToStringFunc(int), std::atomic<long long>& totalTimeUsRef, std::atomic<size_t>& totalCallsRef)
     {
-        benchmarks.emplace_back(title, subtype, typeToStringFunc, totalTimeRef, totalCallsRef);
+        std::lock_guard<std::mutex> lock(benchmarksMutex);
+        benchmarks.emplace_back(title, subtype, typeToStringFunc, &totalTimeUsRef, &totalCallsRef);
     }
 
     static void Reset()
     {
+        std::lock_guard<std::mutex> lock(benchmarksMutex);
         for (auto& elem : benchmarks)
         {
-            std::chrono::microseconds& totalTime = std::get<3>(elem).get();
-            size_t& totalCalls = std::get<4>(elem).get();
-            totalTime = std::chrono::microseconds::zero();
-            totalCalls = 0;
+            *std::get<3>(elem) = 0;
+            *std::get<4>(elem) = 0;
         }
         benchmarks.clear();
     }
@@ -260,30 +266,32 @@ public:
 
 template <StringLiteral title, int subtype = 0, const char* typeToStringFunc(int) = nullptr>
 class BenchmarkT {
-    static std::chrono::microseconds totalTime;
-    static size_t totalCalls;
+    static std::atomic<long long> totalTimeUs;
+    static std::atomic<size_t> totalCalls;
     union {
         std::chrono::steady_clock::time_point start;
         long long raw; // time_point raw value.
     };
 
+    void AddTime()
+    {
+        std::chrono::steady_clock::time_point end(std::chrono::high_resolution_clock::now());
+        totalTimeUs.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), std::memory_order_relaxed);
+    }
 public:
     BenchmarkT() : start(std::chrono::high_resolution_clock::now())
     {
-        if (!totalCalls++) { BenchmarkTCollector::Add(title.value, subtype, typeToStringFunc, totalTime, totalCalls); }
+        // Only the thread making the first call registers the probe.
+        if (!totalCalls.fetch_add(1, std::memory_order_relaxed)) { BenchmarkTCollector::Add(title.value, subtype, typeToStringFunc, totalTimeUs, totalCalls); }
     }
     ~BenchmarkT()
     {
         if(!raw) return;
-        std::chrono::steady_clock::time_point end(std::chrono::high_resolution_clock::now());
-        std::chrono::microseconds time = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-        totalTime += time;
+        AddTime();
     }
     void Stop()
     {
-        std::chrono::steady_clock::time_point end(std::chrono::high_resolution_clock::now());
-        std::chrono::microseconds time = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-        totalTime += time;
+        AddTime();
         raw = 0;
     }
 
@@ -291,7 +299,6 @@ public:
 };
 
 template <StringLiteral title, int subtype, const char* typeToStringFunc(int)>
-std::chrono::microseconds BenchmarkT<title, subtype, typeToStringFunc>::totalTime;
+std::atomic<long long> BenchmarkT<title, subtype, typeToStringFunc>::totalTimeUs = 0;
 template <StringLiteral title, int subtype, const char* typeToStringFunc(int)>
-size_t BenchmarkT<title, subtype, typeToStringFunc>::totalCalls = 0;
-
+std::atomic<size_t> BenchmarkT<title, subtype, typeToStringFunc>::totalCalls = 0;
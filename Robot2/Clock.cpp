@@ -0,0 +1,21 @@
+#include "Clock.h"
+#include <chrono>
+#include <thread>
+#include <SDL2/SDL_timer.h>
+
+uint32_t RealClock::NowMs()
+{
+	return SDL_GetTicks();
+}
+
+void RealClock::SleepMs(uint32_t ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// static
+RealClock& RealClock::Get()
+{
+	static RealClock clock;
+	return clock;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Time source of the Worker and its tasks in milliseconds, real (SDL_GetTicks) or virtual for the simulation.
+class Clock
+{
+public:
+	virtual ~Clock() {}
+	virtual uint32_t NowMs() = 0;
+	virtual void SleepMs(uint32_t ms) = 0;
+};
+
+class RealClock : public Clock
+{
+public:
+	uint32_t NowMs() override;
+	void SleepMs(uint32_t ms) override;
+	static RealClock& Get();
+};
+
+// Only moves when slept on or advanced, so hours of waits pass in no time.
+class VirtualClock : public Clock
+{
+	std::atomic<uint32_t> nowMs{ 0 };
+public:
+	uint32_t NowMs() override { return this->nowMs; }
+	void SleepMs(uint32_t ms) override { this->nowMs += ms; }
+	void Advance(uint32_t ms) { this->nowMs += ms; }
+};
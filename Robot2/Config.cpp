@@ -1,10 +1,19 @@
 #include "Config.h"
 #include "Worker.h"
+#include "detect/DescriptorCache.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <filesystem>
 #include <ranges>
 #include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
 #include <SDL2/SDL_timer.h>
 #include "Random.h"
 
@@ -62,7 +71,7 @@ void Config::ExtractRequirementsIntoAction(libconfig::Setting& setting, Action&
     if (setting.exists("timeout")) {
         int timeoutMs = Config::TimeParse(setting.lookup("timeout"));
 
-        action.requirements.emplace_back(new Config::TimeoutRequirement(timeoutMs));
+        action.requirements.push_back(Requirement::Timeout(timeoutMs));
     }
     if (setting.exists("object"))
     {
@@ -94,9 +103,9 @@ void Config::ExtractObjectRequirementIntoAction(libconfig::Setting& setting, Act
         return;
     }
     cv::Rect2f screenMarginMul(Config::MarginMultiplierParse(setting));
-    
-    //action.objReqs.emplace_back(objIndex, notFoundCheck, screenMarginMul);
-    action.requirements.emplace_back(new Config::ObjectRequirement(objIndex, notFoundCheck, screenMarginMul, this->minDetectionQuality));
+    int maxAgeMs = setting.exists("max_age") ? Config::TimeParse(setting.lookup("max_age")) : 0;
+
+    action.requirements.push_back(Requirement::Object(objIndex, notFoundCheck, screenMarginMul, this->minDetectionQuality, maxAgeMs));
 }
 
 void Config::ExtractTasksIntoAction(libconfig::Setting& setting, Action& action)
@@ -298,6 +307,28 @@ void Config::RangeParse(libconfig::Setting& setting, cv::Rect2f& marginMul)
     }
 }
 
+void Config::LoadDetectorParams(libconfig::Config& config)
+{
+    // Only the given keys are overwritten, so parameters can be split between config files (e.g. @include "tuned_detector.cfg").
+    ObjDetect::DetectorParams& p = this->detectorParams;
+    config.lookupValue("orb_features", p.orbFeatures);
+    config.lookupValue("orb_scale", p.orbScale);
+    config.lookupValue("orb_levels", p.orbLevels);
+    config.lookupValue("orb_edge_threshold", p.orbEdgeThreshold);
+    config.lookupValue("orb_patch_size", p.orbPatchSize);
+    config.lookupValue("orb_fast_threshold", p.orbFastThreshold);
+    config.lookupValue("orb_beblid_scale", p.orbBeblidScale);
+    config.lookupValue("brisk_threshold", p.briskThreshold);
+    config.lookupValue("brisk_octaves", p.briskOctaves);
+    config.lookupValue("brisk_pattern_scale", p.briskPatternScale);
+    config.lookupValue("brisk_beblid_scale", p.briskBeblidScale);
+    config.lookupValue("surf_hessian", p.surfHessian);
+    config.lookupValue("surf_octaves", p.surfOctaves);
+    config.lookupValue("surf_layers", p.surfLayers);
+    config.lookupValue("surf_beblid_scale", p.surfBeblidScale);
+    config.lookupValue("sift_beblid_scale", p.siftBeblidScale);
+}
+
 bool Config::LoadConfig(const std::string& filePath)
 {
     bool testOnlyConfig = true;
@@ -317,6 +348,7 @@ bool Config::LoadConfig(const std::string& filePath)
             << " - " << pex.getError() << std::endl;
         return testOnlyConfig;
     }
+    this->LoadDetectorParams(config);
     if (config.exists("tests"))
     {
         libconfig::Setting& testsSetting = config.lookup("tests");
@@ -325,6 +357,22 @@ bool Config::LoadConfig(const std::string& filePath)
             std::cerr << "tests config entry is not a list, use \"()\" braces!\n";
             return testOnlyConfig;
         }
+        this->LoadSetting(config, "test_results", this->testResultsPath, "");
+        this->LoadSetting(config, "test_baseline", this->testBaselinePath, "");
+        this->LoadSetting(config, "test_max_time_regression", this->testMaxTimeRegression, 0.25f);
+        this->LoadSetting(config, "test_max_point_drop", this->testMaxPointDrop, 0.5f);
+
+        std::string strTuneDetector, strTuneMatcher;
+        this->LoadSetting(config, "tune_samples", this->tuneOptions.samples, 0);
+        this->LoadSetting(config, "tune_seed", this->tuneOptions.seed, 1);
+        this->LoadSetting(config, "tune_latency_budget_ms", this->tuneOptions.latencyBudgetMs, 0.f);
+        this->LoadSetting(config, "tune_detector", strTuneDetector, "ORB_BEBLID");
+        this->LoadSetting(config, "tune_matcher", strTuneMatcher, "BRUTEFORCE_HAMMING");
+        this->LoadSetting(config, "tune_channel", this->tuneOptions.channel, "Grayscale");
+        this->LoadSetting(config, "tune_pareto", this->tuneOptions.paretoPath, "tune_pareto.csv");
+        this->LoadSetting(config, "tune_output", this->tuneOptions.outputPath, "tuned_detector.cfg");
+        this->tuneOptions.detector = magic_enum::enum_cast<ObjDetect::Detector>(strTuneDetector).value_or(ObjDetect::Detector::ORB_BEBLID);
+        this->tuneOptions.matcher = magic_enum::enum_cast<cv::DescriptorMatcher::MatcherType>(strTuneMatcher).value_or(cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING);
         for (libconfig::SettingIterator testIt = testsSetting.begin(); testIt != testsSetting.end(); ++testIt)
         {
             std::string baseImagePath, templateImagePath;
@@ -351,15 +399,24 @@ bool Config::LoadConfig(const std::string& filePath)
             for (libconfig::SettingIterator objIt = objSetting.begin(); objIt != objSetting.end(); ++objIt)
             {
                 std::string image, name;
+                float scale = 0;
+                int scanIntervalMs = 0, priority = 0;
                 objIt->lookupValue("image", image);
                 objIt->lookupValue("name", name);
+                objIt->lookupValue("scale", scale);
+                if (objIt->exists("scan_interval")) { scanIntervalMs = Config::TimeParse(objIt->lookup("scan_interval")); }
+                objIt->lookupValue("priority", priority);
                 this->objects.emplace_back(image, name);
+                this->objectScales.push_back(scale);
+                this->objectScanIntervals.push_back(scanIntervalMs);
+                this->objectPriorities.push_back(priority);
                 this->objNameToIndex.insert(std::pair(name, this->objects.size()-1));
             }
         }
         std::string strDetector, strMatcher;
         this->LoadSetting(config, "scan_wait_ms", this->scanWaitMs, 500);
         this->LoadSetting(config, "scan_wait_random_ms", this->scanWaitRandomMs, 0);
+        this->LoadSetting(config, "scan_object_limit", this->scanObjectLimit, 0);
         this->LoadSetting(config, "image_channel", this->image_channel, "Grayscale");
         this->LoadSetting(config, "detector", strDetector, "ORB_BEBLID");
         this->LoadSetting(config, "matcher", strMatcher, "BRUTEFORCE_HAMMING");
@@ -368,6 +425,32 @@ bool Config::LoadConfig(const std::string& filePath)
         this->LoadSetting(config, "estimator_history", this->estimator_history, 8);
         this->LoadSetting(config, "min_detect_quality", this->minDetectionQuality, 0.1f);
         this->LoadSetting(config, "thread_count", this->threadCount, -1);
+        this->LoadSetting(config, "detect_scale", this->detectScale, 1.f);
+        this->LoadSetting(config, "detect_refine", this->detectRefine, false);
+        this->LoadSetting(config, "color_prefilter", this->colorPrefilter, 0.f);
+        this->LoadSetting(config, "decoder_threads", this->decoderThreads, 1);
+        this->LoadSetting(config, "decoder_thread_type", this->decoderThreadType, "slice");
+        this->LoadSetting(config, "decoder_low_delay", this->decoderLowDelay, false);
+        this->LoadSetting(config, "decoder_fast", this->decoderFast, false);
+        this->LoadSetting(config, "frame_image_channel", this->frameImageChannel, false);
+        if (this->colorPrefilter > 0 && this->frameImageChannel) {
+            const std::string& ch = this->image_channel;
+            if (ch == "Grayscale" || ch == "grayscale" || ch == "R" || ch == "G" || ch == "B") { // Same names as sc_frame_format_from_channel.
+                // The decoder only delivers the detection channel, the prefilter has no colours to compare.
+                std::cerr << "color_prefilter has no effect with frame_image_channel and single channel (" << ch << ") frames.\n";
+            }
+        }
+        this->LoadSetting(config, "stream_auto", this->streamAuto, false);
+        this->LoadSetting(config, "stream_max_fps", this->streamMaxFps, 0);
+        this->LoadSetting(config, "stream_bit_rate", this->streamBitRate, 0);
+        this->LoadSetting(config, "render_idle_fps", this->renderIdleFps, 0);
+        this->LoadSetting(config, "render_upload_bands", this->renderUploadBands, false);
+        this->LoadSetting(config, "device_priority", this->devicePriority, 1.f);
+        this->LoadSetting(config, "device_cpu_quota", this->deviceCpuQuota, 0.f);
+        this->LoadSetting(config, "descriptor_cache", this->descriptorCacheDir, "descriptor_cache");
+        if (!this->descriptorCacheDir.empty()) { // Relative to the config file.
+            this->descriptorCacheDir = (std::filesystem::path(filePath).parent_path() / this->descriptorCacheDir).string();
+        }
 
         std::optional<ObjDetect::Detector> detector = magic_enum::enum_cast<ObjDetect::Detector>(strDetector);
         if (detector.has_value()) { this->detector = detector.value(); }
@@ -411,18 +494,22 @@ bool Config::LoadConfig(const std::string& filePath)
                 {
                     // Add action to state.
                     sAcList.push_back(actionInd);
-                    // Add objects to state.
-                    //for (const ObjectRequirement& objr : action.objReqs) { this->states[stateInd].SetObjectToDetect(objr.GetObjIndex()); }
-                    for (const std::unique_ptr<Requirement>& req : action.requirements) {
-                        const ObjectRequirement* objReq = dynamic_cast<const ObjectRequirement*>(&*req);
-                        if (objReq) {
-                            this->states[stateInd].SetObjectToDetect(objReq->GetObjIndex());
-                        }
-                    }
                 }
             }
         }
 
+        // Compile the state machine, the objects of the states come from the compiled object bitsets.
+        this->decisionTable = DecisionTable(this->GetObjectCount());
+        for (const Action& action : this->actions) { this->decisionTable.AddAction(action.requirements); }
+        for (State& state : this->states)
+        {
+            const int stateInd = this->decisionTable.AddState(std::vector<int>(state.actionInds.begin(), state.actionInds.end()));
+            for (int objInd = 0; objInd < this->GetObjectCount(); objInd++)
+            {
+                if (this->decisionTable.IsObjectInState(stateInd, objInd)) { state.SetObjectToDetect(objInd); }
+            }
+        }
+
         // Set inital state.
         if (config.exists("init_state")) {
             std::string stateStr = config.lookup("init_state");
@@ -449,18 +536,111 @@ bool Config::LoadConfig(const std::string& filePath)
     return testOnlyConfig;
 }
 
-ObjDetect Config::CreateDetector()
+ObjDetect Config::CreateDetector(float streamScale, const ObjDetect* previous)
 {
-    ObjDetect result(this->detector, this->matcher, this->image_channel);
-    for (const std::pair<std::string, std::string>& object : this->objects)
-    {
-        const std::string& imagePath = object.first;
-        cv::Mat objImage = cv::imread(imagePath);
-        result.AddObject(objImage);
-    }
+    ObjDetect result(this->detector, this->matcher, this->image_channel, &this->detectorParams); // Own params, the devices may use different configs.
+    // A downscaled stream already did (a part of) the detection downsampling.
+    result.SetScale(std::min(1.f, this->detectScale / streamScale), this->detectRefine);
+    result.SetColorPrefilter(this->colorPrefilter);
+
+    // The objects are loaded and their features computed on parallel threads, then added in config order.
+    // Features computed earlier with the same image and settings are taken from the previous detector or the descriptor cache.
+    const DescriptorCache cache(this->descriptorCacheDir);
+    std::map<std::string, const ObjDetect::ImageFeatures*> previousFeatures;
+    if (previous) {
+        for (const ObjDetect::ImageFeatures& objFeatures : previous->GetObjects()) { previousFeatures.emplace(objFeatures.source, &objFeatures); }
+    }
+    const size_t objectCount = this->objects.size();
+    std::vector<ObjDetect::ImageFeatures> features(objectCount);
+    std::atomic<size_t> nextObject = 0;
+    size_t loadedObjects = 0, cachedObjects = 0, reusedObjects = 0;
+    std::mutex progressMutex;
+    auto loadObjects = [&]() {
+        for (size_t i; (i = nextObject++) < objectCount; ) try {
+            const std::string& imagePath = this->objects[i].first;
+            float scale = this->objectScales[i];
+            if (streamScale < 1 && scale > 0) scale = std::min(1.f, scale / streamScale);
+
+            std::ostringstream settings;
+            settings << "stream_scale=" << streamScale << ' ' << result.GetFeatureSettings(scale);
+            // The modification time and size stand for the content here, the image is not read when the features are reused.
+            std::error_code fileError;
+            std::ostringstream source;
+            source << imagePath << '|' << std::filesystem::file_size(imagePath, fileError) << '|'
+                << std::filesystem::last_write_time(imagePath, fileError).time_since_epoch().count() << '|' << settings.str();
+            auto previousIt = previousFeatures.find(source.str());
+            if (previousIt != previousFeatures.end()) {
+                features[i] = *previousIt->second;
+                std::lock_guard<std::mutex> lock(progressMutex);
+                reusedObjects++; loadedObjects++;
+                continue;
+            }
+
+            std::ifstream file(imagePath, std::ios::binary);
+            std::vector<uint8_t> imageFile;
+            if (file) { imageFile.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()); }
+            if (imageFile.empty()) {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                std::cout << "\nObject image " << std::quoted(imagePath) << " is missing or empty.\n";
+            }
+            const std::string key = (cache.IsEnabled() && !imageFile.empty()) ? DescriptorCache::GetKey(imageFile, settings.str()) : std::string();
+            const bool isCached = !key.empty() && cache.Load(key, features[i]);
+            if (!isCached) {
+                cv::Mat objImage = imageFile.empty() ? cv::Mat() : cv::imdecode(imageFile, cv::IMREAD_COLOR); // Empty if not an image.
+                if (streamScale < 1 && !objImage.empty()) { // Object images are cut from full resolution screenshots.
+                    cv::resize(objImage, objImage, cv::Size(), streamScale, streamScale, cv::INTER_AREA);
+                }
+                features[i] = result.ComputeObject(objImage, scale);
+                if (!objImage.empty()) { cache.Store(key, features[i]); }
+            }
+            features[i].source = source.str();
+
+            std::lock_guard<std::mutex> lock(progressMutex);
+            if (isCached) { cachedObjects++; }
+            std::cout << "\rLoading objects: " << ++loadedObjects << '/' << objectCount << " (" << cachedObjects << " cached)" << std::flush;
+        }
+        catch (const std::exception& e) { // A bad object is never found, the others are still loaded.
+            features[i] = ObjDetect::ImageFeatures();
+            std::lock_guard<std::mutex> lock(progressMutex);
+            std::cout << "\nCannot load object " << std::quoted(this->objects[i].first) << ": " << e.what() << '\n';
+            loadedObjects++;
+        }
+    };
+    const size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), objectCount);
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < threadCount; t++) { threads.emplace_back(loadObjects); }
+    loadObjects();
+    for (std::thread& thread : threads) { thread.join(); }
+    if (reusedObjects < objectCount) { std::cout << '\n'; } // End of the progress line.
+    if (previous) { std::cout << "Reused the features of " << reusedObjects << '/' << objectCount << " objects.\n"; }
+
+    for (ObjDetect::ImageFeatures& objFeatures : features) { result.AddObject(std::move(objFeatures)); }
     return result;
 }
 
+int Config::GetStreamMaxFps() const
+{
+    if (this->streamMaxFps > 0 || !this->streamAuto) return this->streamMaxFps;
+    // Two frames per scan period, so the scanned frame is at most half a period old.
+    return std::clamp((int)std::ceil(2000.f / std::max(1, this->scanWaitMs)), 2, 60);
+}
+
+int Config::GetStreamBitRate() const
+{
+    if (this->streamBitRate > 0 || !this->streamAuto) return this->streamBitRate;
+    // scrcpy's 8 Mbps default is sized for full resolution 60 fps mirroring.
+    const float scale = this->GetStreamScale();
+    return std::max(1000000, (int)(8000000 * scale * scale));
+}
+
+float Config::GetStreamScale() const
+{
+    if (!this->streamAuto || this->detectRefine) return 1; // The refinement needs full resolution frames.
+    float scale = this->detectScale;
+    for (float objectScale : this->objectScales) { scale = std::max(scale, objectScale); }
+    return std::clamp(scale, 0.05f, 1.f);
+}
+
 int Config::GetScanWaitMs() const
 {
     return this->scanWaitMs + Random(scanWaitRandomMs);
@@ -480,62 +660,20 @@ cv::Rect Config::ApplyMarginMulToSize(const cv::Rect2f& marginMul, const cv::Siz
     return Config::ApplyMarginMulToRectangle(marginMul, cv::Rect(cv::Point(0, 0), s));
 }
 
-bool Config::TimeoutRequirement::IsSatisfied(Worker* worker) const
-{
-    return bool(worker->GetNow() - worker->GetLastAction() > this->timeoutMs);
-}
-
-bool Config::ObjectRequirement::IsSatisfied(Worker* worker) const //const std::vector<std::vector<cv::Rect>>& detections, int width, int height) const
-{
-    bool found = false;
-    cv::Rect scanRegion = this->CalculateScanRect(worker->GetFixResConfig().GetSize());
-
-    std::vector<std::vector<RectProb>>& lastDetection = worker->GetLastDetection();
-    if (this->objIndex >= lastDetection.size()) {
-        printf("ObjectRequirement Error: lastDetection is smaller than object index!\n");
-        return false;
-    }
-    std::vector<RectProb>& objDetection = lastDetection[this->objIndex];
-    for (RectProb& rect : objDetection)
-    {
-        if (rect.p >= this->minDetectQuality && (rect & scanRegion).area())
-        {
-            //worker->GetFirstValidRect()[this->objIndex] = &rect - (&*objDetection.begin());
-            //return !this->notFoundCheck;
-            found = true;
-        }
-        else {
-            rect.isExcluded = true;
-        }
-    }
-    return this->notFoundCheck ^ found;
-}
-
-void Config::ObjectRequirement::UpdateScreenSize(const cv::Size screenSize)
-{
-
-}
-
-cv::Rect Config::ObjectRequirement::CalculateScanRect(const cv::Size screenSize) const
-{
-    return Config::ApplyMarginMulToSize(this->screenMarginMul, screenSize);
-}
-
-void Config::WaitTask::Execute(Worker& worker)
+uint32_t Config::WaitTask::Execute(Worker& worker)
 {
-    worker.GetInfos().Commit();
-    int sleepMs = this->delayMs + Random(this->randomDelayMs);
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
-    worker.UpdateNow();
+    worker.CommitInfos();
+    return this->delayMs + Random(this->randomDelayMs);
 }
 
-void Config::SetStateTask::Execute(Worker& worker)
+uint32_t Config::SetStateTask::Execute(Worker& worker)
 {
     worker.SetState(this->newState);
     std::cout << std::format("Entering new state: {}\n", worker.GetState()->name);
+    return 0;
 }
 
-void Config::CounterIncrementTask::Execute(Worker& worker)
+uint32_t Config::CounterIncrementTask::Execute(Worker& worker)
 {
     if (worker.GetState() == this->curState) {
         bool isLimitReached = worker.GetEstimator().Add(worker.GetNow(), this->increment);
@@ -543,9 +681,10 @@ void Config::CounterIncrementTask::Execute(Worker& worker)
         std::cout << std::format("Counter incremented (+{})\n", this->increment);
         worker.GetEstimator().Display(worker.GetNow());
     }
+    return 0;
 }
 
-void Config::ClickTask::Execute(Worker& worker)
+uint32_t Config::ClickTask::Execute(Worker& worker)
 {
     const RectProb* selectedObjRect;
     RectProb screenRect;
@@ -602,7 +741,7 @@ void Config::ClickTask::Execute(Worker& worker)
     }
     if (selectedObjRect == nullptr) {
         printf("No valid rectangle for ClickTask.\n");
-        return;
+        return 0;
     }
 
     // Apply margin.
@@ -614,6 +753,12 @@ void Config::ClickTask::Execute(Worker& worker)
     worker.GetInfos().GetLive().SetClickTime(worker.GetNow(), p.x, p.y, &shrinkedObjRect);
     // Send event.
     worker.SendTouchEvent(p, true);
-    std::this_thread::sleep_for(std::chrono::milliseconds(this->delayMs + Random(this->randomDelayMs)));
-    worker.SendTouchEvent(p, false);
+    // The release is scheduled before the next task's step, which runs after the press.
+    uint32_t pressMs = this->delayMs + Random(this->randomDelayMs);
+    if (pressMs == 0) { // A following click would be pressed before this release ran.
+        worker.SendTouchEvent(p, false);
+        return 0;
+    }
+    worker.GetTaskScheduler().Schedule(worker.GetNow() + pressMs, [&worker, p] { worker.SendTouchEvent(p, false); });
+    return pressMs;
 }
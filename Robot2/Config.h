@@ -6,6 +6,7 @@
 #include "detect/Tests.h"
 #include "magic_enum.hpp"
 #include "detect/ObjDetect.h"
+#include "DecisionTable.h"
 
 // https://stackoverflow.com/questions/29263090/ffmpeg-avframe-to-opencv-mat-conversion/29265787
 // http://www.partow.net/programming/exprtk/
@@ -29,37 +30,11 @@ public:
 			this->hasObjectToDetect = true;
 		}
 	};
-	class Requirement {
-	public:
-		Requirement() {}
-		virtual ~Requirement() {}
-		virtual bool IsSatisfied(Worker* worker) const = 0;
-		virtual void UpdateScreenSize(const cv::Size screenSize) {}
-	};
-	class TimeoutRequirement : public Requirement {
-		int timeoutMs;
-	public:
-		TimeoutRequirement(int timeoutMs) : timeoutMs(timeoutMs) {}
-		virtual ~TimeoutRequirement() {}
-		virtual bool IsSatisfied(Worker* worker) const;
-	};
-	class ObjectRequirement : public Requirement {
-		int objIndex;
-		bool notFoundCheck;
-		cv::Rect2f screenMarginMul; // note: width and height are treated as right and bottom margins.
-		cv::Rect scanRegion;
-		float minDetectQuality;
-	public:
-		ObjectRequirement(int objIndex, bool notFoundCheck, cv::Rect2f screenMarginMul, float minDetectQuality) :objIndex(objIndex), notFoundCheck(notFoundCheck), screenMarginMul(screenMarginMul), minDetectQuality(minDetectQuality){}
-		virtual ~ObjectRequirement() {}
-		virtual bool IsSatisfied(Worker* worker) const;
-		virtual void UpdateScreenSize(const cv::Size screenSize);
-		cv::Rect CalculateScanRect(const cv::Size screenSize) const;
-		int GetObjIndex() const { return objIndex; }
-	};
+	using Requirement = DecisionTable::Requirement; // Evaluated through the compiled DecisionTable.
 	class Task {
 	public:
-		virtual void Execute(Worker& worker) {}
+		// Returns the time in ms until the next task of the action can run, the Worker keeps detecting meanwhile.
+		virtual uint32_t Execute(Worker& worker) { return 0; }
 	};
 	class ClickTask : public Task {
 #define CLICKTASK_SELECT_FIRST 0
@@ -70,35 +45,43 @@ public:
 		int objInd, delayMs, randomDelayMs; cv::Rect2f marginMul; char selectMode;
 	public:
 		ClickTask(int objInd, int delayMs, int randomDelayMs, cv::Rect2f marginMul, char selectMode) :objInd(objInd), delayMs(delayMs), randomDelayMs(randomDelayMs), marginMul(marginMul), selectMode(selectMode){}
-		virtual void Execute(Worker& worker);
+		virtual uint32_t Execute(Worker& worker);
 	};
 	class WaitTask : public Task {
 		int delayMs, randomDelayMs;
 	public:
 		WaitTask(int delayMs, int randomDelayMs) :delayMs(delayMs), randomDelayMs(randomDelayMs) {}
-		virtual void Execute(Worker& worker);
+		virtual uint32_t Execute(Worker& worker);
 	};
 	class CounterIncrementTask : public Task {
 		int increment;
 		const State* curState;
 	public:
 		CounterIncrementTask(int increment, const State* curState) :increment(increment), curState(curState){}
-		virtual void Execute(Worker& worker);
+		virtual uint32_t Execute(Worker& worker);
 	};
 	class SetStateTask : public Task {
 		int newState;
 	public:
 		SetStateTask(int newState) :newState(newState){}
-		virtual void Execute(Worker& worker);
+		virtual uint32_t Execute(Worker& worker);
+	};
+	class TuneOptions
+	{
+	public:
+		int samples = 0, seed = 1; // Tuning is off when samples is 0.
+		float latencyBudgetMs = 0;
+		ObjDetect::Detector detector = ObjDetect::Detector::ORB_BEBLID;
+		cv::DescriptorMatcher::MatcherType matcher = cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING;
+		std::string channel, paretoPath, outputPath;
 	};
 	class Action
 	{
 	public:
 		std::list<int> states; // The states which the action can be called from.
 		std::list<int> state_blacklist; // The states which the action cannot be called from. After loading the config file the states are updated based on this list (states := all state - blacklisted states).
-		std::list<std::unique_ptr<Requirement>> requirements; // Requirements to fire the action.
-		//std::list<ObjectRequirement> objReqs; // Object detection requirements.
-		std::list<std::unique_ptr<Task>> tasks; // Tasks to execute when the action is fired.
+		std::vector<Requirement> requirements; // Requirements to fire the action.
+		std::vector<std::unique_ptr<Task>> tasks; // Tasks to execute when the action is fired.
 
 		Action() {}
 		~Action() {}
@@ -113,18 +96,37 @@ public:
 private:
 	std::list<ObjDetectTest> tests;
 	std::vector<std::pair<std::string, std::string>> objects;
+	std::vector<float> objectScales; // Per object detection scale, 0 = detect_scale.
+	std::vector<int> objectScanIntervals; // Per object minimum time between two scans in ms, 0 = every scan.
+	std::vector<int> objectPriorities; // Higher is scanned first when more objects are due than scan_object_limit.
 	std::vector<State> states;
 	std::vector<Action> actions;
+	DecisionTable decisionTable; // The states, actions and requirements above in the evaluated form.
 	std::map<std::string, int> objNameToIndex;
 	std::map<std::string, int> stateNameToIndex;
 
-	int scanWaitMs, scanWaitRandomMs, counter_limit, estimator_history, initialState, threadCount;
-	float minDetectionQuality;
+	int scanWaitMs, scanWaitRandomMs, counter_limit, estimator_history, initialState, threadCount, scanObjectLimit;
+	float minDetectionQuality, detectScale, colorPrefilter;
+	bool detectRefine;
+	int decoderThreads;
+	std::string decoderThreadType;
+	bool decoderLowDelay, decoderFast;
+	bool frameImageChannel;
+	bool streamAuto;
+	int streamMaxFps, streamBitRate;
+	int renderIdleFps;
+	bool renderUploadBands;
+	float devicePriority, deviceCpuQuota;
 	std::string image_channel, source;
+	std::string descriptorCacheDir; // Empty = no descriptor cache.
 	ObjDetect::Detector detector;
 	cv::DescriptorMatcher::MatcherType matcher;
 
 	std::string name;
+	std::string testResultsPath, testBaselinePath;
+	float testMaxTimeRegression, testMaxPointDrop;
+	TuneOptions tuneOptions;
+	ObjDetect::DetectorParams detectorParams;
 	
 	template<typename T, typename defT>
 	void LoadSetting(libconfig::Config& setting, const std::string& name, T& value, const defT& defaultValue)
@@ -132,6 +134,7 @@ private:
 		bool found = setting.lookupValue(name, value);
 		if (!found) value = defaultValue;
 	}
+	void LoadDetectorParams(libconfig::Config& config);
 	void InitStates(libconfig::Setting& setting);
 	void ExtractStatesIntoAction(libconfig::Setting& setting, const std::string& settingName, std::list<int>& stateList);
 	int GetStateInd(const std::string& stateName);
@@ -151,15 +154,40 @@ public:
 	std::list<ObjDetectTest>& Tests() { return tests; }
 	const std::vector<State>& GetStates() const { return states; }
 	const std::vector<Action>& GetActions() const { return actions; }
+	const DecisionTable& GetDecisionTable() const { return decisionTable; }
 	const std::vector<std::pair<std::string, std::string>>& GetObjects() const { return objects; }
-	ObjDetect CreateDetector();
+	// streamScale: stream resolution relative to the device resolution.
+	// previous: detector of an earlier config, its features are reused for the objects with the same image and settings.
+	ObjDetect CreateDetector(float streamScale = 1, const ObjDetect* previous = nullptr);
 	int GetThreadCount() const { return this->threadCount; }
+	int GetDecoderThreads() const { return this->decoderThreads; }
+	bool IsDecoderFrameThreaded() const { return this->decoderThreadType == "frame"; }
+	bool IsDecoderLowDelay() const { return this->decoderLowDelay; }
+	bool IsDecoderFast() const { return this->decoderFast; }
+	bool IsFrameImageChannel() const { return this->frameImageChannel; }
+	const std::string& GetImageChannel() const { return this->image_channel; }
+	int GetStreamMaxFps() const; // 0 = unlimited.
+	int GetStreamBitRate() const; // 0 = default.
+	float GetStreamScale() const; // Requested stream resolution relative to the device resolution.
+	int GetRenderIdleFps() const { return this->renderIdleFps; } // 0 = render only when something changed.
+	bool IsRenderUploadBands() const { return this->renderUploadBands; }
+	float GetDevicePriority() const { return this->devicePriority; } // Share of the detection threads in multi-device mode.
+	float GetDeviceCpuQuota() const { return this->deviceCpuQuota; } // Max fraction of the detection threads, 0 = unlimited.
 	const State* GetInitialState() const { return &this->states[this->initialState]; }
 	int GetScanWaitMs() const;
+	int GetScanObjectLimit() const { return this->scanObjectLimit; } // Max objects scanned per frame, 0 = unlimited.
+	int GetObjectScanInterval(int ind) const { return this->objectScanIntervals[ind]; }
+	int GetObjectPriority(int ind) const { return this->objectPriorities[ind]; }
 	int GetCounterLimit() const { return this->counter_limit; }
 	int GetObjectCount() const { return this->objects.size(); }
 	const std::string& GetObjectName(int ind) const { return std::get<1>(this->objects[ind]); }
 	const std::string& GetName() const { return this->name; }
+	const std::string& GetTestResultsPath() const { return this->testResultsPath; }
+	const std::string& GetTestBaselinePath() const { return this->testBaselinePath; }
+	float GetTestMaxTimeRegression() const { return this->testMaxTimeRegression; }
+	float GetTestMaxPointDrop() const { return this->testMaxPointDrop; }
+	const TuneOptions& GetTuneOptions() const { return this->tuneOptions; }
+	const ObjDetect::DetectorParams& GetDetectorParams() const { return this->detectorParams; }
 
 	static cv::Rect ApplyMarginMulToRectangle(const cv::Rect2f& marginMul, const cv::Rect& r);
 	static cv::Rect ApplyMarginMulToSize(const cv::Rect2f& marginMul, const cv::Size& s);
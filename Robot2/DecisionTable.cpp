@@ -0,0 +1,136 @@
+#include "DecisionTable.h"
+#include "Config.h"
+#include "detect/StageBenchmark.h"
+#include <random>
+#include <iostream>
+#include "termcolor.hpp"
+
+DecisionTable::DecisionTable(int objectCount) : objectCount(objectCount), objectWords((objectCount + 63) / 64)
+{
+}
+
+int DecisionTable::AddAction(std::span<const Requirement> actionRequirements)
+{
+	Action& action = this->actions.emplace_back();
+	action.firstRequirement = (uint32_t)this->requirements.size();
+	action.requirementCount = (uint32_t)actionRequirements.size();
+	this->requirements.insert(this->requirements.end(), actionRequirements.begin(), actionRequirements.end());
+	return (int)this->actions.size() - 1;
+}
+
+int DecisionTable::AddState(std::span<const int> actionInds)
+{
+	const int stateInd = (int)this->states.size();
+	State& state = this->states.emplace_back();
+	state.firstAction = (uint32_t)this->stateActions.size();
+	state.actionCount = (uint32_t)actionInds.size();
+	this->stateObjects.resize(this->stateObjects.size() + this->objectWords, 0);
+	uint64_t* objectBits = &this->stateObjects[(size_t)stateInd * this->objectWords];
+	for (int actionInd : actionInds) {
+		this->stateActions.push_back((uint32_t)actionInd);
+		const Action& action = this->actions[actionInd];
+		for (uint32_t r = action.firstRequirement; r < action.firstRequirement + action.requirementCount; r++) {
+			const Requirement& req = this->requirements[r];
+			if (req.type == Requirement::Type::Object) { objectBits[req.objInd / 64] |= uint64_t(1) << (req.objInd % 64); }
+		}
+	}
+	return stateInd;
+}
+
+inline bool DecisionTable::IsSatisfied(uint32_t reqInd, const Context& context) const
+{
+	const Requirement& req = this->requirements[reqInd];
+	switch (req.type) {
+	case Requirement::Type::Timeout:
+		return context.nowMs - context.lastActionMs > (uint32_t)req.timeoutMs;
+	case Requirement::Type::Object: {
+		std::vector<std::vector<RectProb>>& detections = *context.detections;
+		if (req.objInd >= detections.size()) {
+			printf("ObjectRequirement Error: lastDetection is smaller than object index!\n");
+			return false;
+		}
+		if (req.maxAgeMs && context.objectScanMs) {
+			const int64_t scanMs = (*context.objectScanMs)[req.objInd];
+			if (scanMs < 0 || (int64_t)context.nowMs - scanMs > req.maxAgeMs) { return false; } // Too old to decide either way.
+		}
+		const cv::Rect& scanRect = (*context.scanRects)[reqInd];
+		bool found = false;
+		for (RectProb& rect : detections[req.objInd])
+		{
+			if (rect.p >= req.minDetectQuality && (rect & scanRect).area()) { found = true; }
+			else { rect.isExcluded = true; }
+		}
+		return req.notFoundCheck ^ found;
+	}
+	}
+	return false;
+}
+
+int DecisionTable::FindSatisfiedAction(int stateInd, uint32_t& pos, const Context& context) const
+{
+	const State& state = this->states[stateInd];
+	while (pos < state.actionCount) {
+		const uint32_t actionInd = this->stateActions[state.firstAction + pos++];
+		const Action& action = this->actions[actionInd];
+		uint32_t r = action.firstRequirement;
+		const uint32_t end = r + action.requirementCount;
+		while (r < end && this->IsSatisfied(r, context)) { r++; }
+		if (r == end) { return (int)actionInd; }
+	}
+	return -1;
+}
+
+std::vector<cv::Rect> DecisionTable::ComputeScanRects(const cv::Size& screenSize) const
+{
+	std::vector<cv::Rect> scanRects(this->requirements.size());
+	for (size_t i = 0; i < this->requirements.size(); i++) {
+		if (this->requirements[i].type == Requirement::Type::Object) {
+			scanRects[i] = Config::ApplyMarginMulToSize(this->requirements[i].screenMarginMul, screenSize);
+		}
+	}
+	return scanRects;
+}
+
+// static
+void DecisionTable::Benchmark(StageBenchmark& bench)
+{
+	const int objectCount = 64, stateCount = 16;
+	const cv::Size screenSize(1080, 2400);
+	std::cout << termcolor::bright_white << "Decision table" << termcolor::reset << '\n';
+	for (int actionCount : {100, 300, 1000}) {
+		std::mt19937 rng(0xdec1de);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		// Every action has 1-3 object requirements (some with an extra timeout) and belongs to 1-4 random states.
+		DecisionTable table(objectCount);
+		std::vector<std::vector<int>> actionsPerState(stateCount);
+		for (int a = 0; a < actionCount; a++) {
+			std::vector<Requirement> reqs;
+			if (rng() % 4 == 0) { reqs.push_back(Requirement::Timeout(rng() % 2000)); }
+			for (int r = 0, n = 1 + rng() % 3; r < n; r++) {
+				cv::Rect2f marginMul(unit(rng) * 0.5f, unit(rng) * 0.5f, unit(rng) * 0.5f, unit(rng) * 0.5f);
+				reqs.push_back(Requirement::Object(rng() % objectCount, rng() % 3 == 0, marginMul, 0.5f));
+			}
+			table.AddAction(reqs);
+			for (int s = 0, n = 1 + rng() % 4; s < n; s++) { actionsPerState[rng() % stateCount].push_back(a); }
+		}
+		for (const std::vector<int>& actionInds : actionsPerState) { table.AddState(actionInds); }
+
+		std::vector<std::vector<RectProb>> detections(objectCount);
+		for (std::vector<RectProb>& rects : detections) {
+			for (int i = 0, n = rng() % 4; i < n; i++) {
+				rects.emplace_back(cv::Rect(rng() % 1000, rng() % 2300, 80, 80), unit(rng));
+			}
+		}
+		const std::vector<cv::Rect> scanRects = table.ComputeScanRects(screenSize);
+		const Context context{ 1000, 0, &detections, &scanRects, nullptr };
+
+		// A pass evaluates every state's full action list, as if no action's tasks changed the state.
+		bench.Add("FindSatisfiedAction", "all-states", screenSize, actionCount, [&table, &context]() {
+			for (int s = 0; s < (int)table.GetStateCount(); s++) {
+				uint32_t pos = 0;
+				while (table.FindSatisfiedAction(s, pos, context) >= 0) {}
+			}
+			});
+	}
+}
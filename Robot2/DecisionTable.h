@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include "detect/ObjDetect.h"
+
+class StageBenchmark;
+
+// The config's state machine compiled into contiguous arrays which refer to each other by index.
+// Built once when the config is loaded, the per frame action evaluation is a linear scan without virtual calls or allocations.
+class DecisionTable
+{
+public:
+	class Requirement {
+	public:
+		enum class Type : uint8_t { Timeout, Object };
+		Type type;
+		bool notFoundCheck = false;
+		int objInd = -1, timeoutMs = 0;
+		int maxAgeMs = 0; // Oldest accepted result of the object, 0 = any.
+		float minDetectQuality = 0;
+		cv::Rect2f screenMarginMul; // note: width and height are treated as right and bottom margins.
+
+		static Requirement Timeout(int timeoutMs) { Requirement r; r.type = Type::Timeout; r.timeoutMs = timeoutMs; return r; }
+		static Requirement Object(int objInd, bool notFoundCheck, const cv::Rect2f& screenMarginMul, float minDetectQuality, int maxAgeMs = 0) {
+			Requirement r; r.type = Type::Object; r.objInd = objInd; r.notFoundCheck = notFoundCheck; r.screenMarginMul = screenMarginMul; r.minDetectQuality = minDetectQuality; r.maxAgeMs = maxAgeMs; return r;
+		}
+	};
+	class Action {
+	public:
+		uint32_t firstRequirement, requirementCount;
+	};
+	class State {
+	public:
+		uint32_t firstAction, actionCount; // Range in stateActions.
+	};
+	// Inputs of an evaluation, refresh nowMs and lastActionMs after an action's tasks were executed.
+	class Context {
+	public:
+		uint32_t nowMs, lastActionMs;
+		std::vector<std::vector<RectProb>>* detections; // Rects failing an object requirement are marked as excluded.
+		const std::vector<cv::Rect>* scanRects; // ComputeScanRects result for the current resolution.
+		const std::vector<int64_t>* objectScanMs; // Time of each object's last result (-1 = none), nullptr = the ages are not checked.
+	};
+private:
+	std::vector<Requirement> requirements;
+	std::vector<Action> actions;
+	std::vector<State> states;
+	std::vector<uint32_t> stateActions; // Action indices of every state, one after the other.
+	std::vector<uint64_t> stateObjects; // Bitset of the objects to detect per state, objectWords words each.
+	int objectCount, objectWords;
+
+	bool IsSatisfied(uint32_t reqInd, const Context& context) const;
+public:
+	DecisionTable(int objectCount = 0);
+
+	int AddAction(std::span<const Requirement> actionRequirements); // Returns the action index, actions are added before the states.
+	int AddState(std::span<const int> actionInds); // Returns the state index.
+
+	// Index of the first action at or after position pos of the state's action list with every requirement satisfied, pos is moved past it. -1 at the end of the list.
+	int FindSatisfiedAction(int stateInd, uint32_t& pos, const Context& context) const;
+	std::vector<cv::Rect> ComputeScanRects(const cv::Size& screenSize) const; // Scan rect of every requirement (empty for non object requirements).
+
+	size_t GetStateCount() const { return this->states.size(); }
+	std::span<const uint32_t> GetStateActions(int stateInd) const { return std::span<const uint32_t>(this->stateActions).subspan(this->states[stateInd].firstAction, this->states[stateInd].actionCount); }
+	uint32_t GetFirstRequirement(int actionInd) const { return this->actions[actionInd].firstRequirement; }
+	uint32_t GetRequirementCount(int actionInd) const { return this->actions[actionInd].requirementCount; }
+	const Requirement& GetRequirement(uint32_t reqInd) const { return this->requirements[reqInd]; }
+	bool IsObjectInState(int stateInd, int objInd) const { return (this->stateObjects[(size_t)stateInd * this->objectWords + objInd / 64] >> (objInd % 64)) & 1; }
+
+	static void Benchmark(StageBenchmark& bench); // Evaluation of synthetic tables with hundreds of actions.
+};
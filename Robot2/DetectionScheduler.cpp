@@ -0,0 +1,130 @@
+#include "DetectionScheduler.h"
+#include "LatencyTrace.h"
+#include <algorithm>
+#include <cstdio>
+
+DetectionScheduler::DetectionScheduler(int threadCount)
+{
+	if (threadCount <= 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+	this->windowStartUs = this->lastReportUs = LatencyTrace::NowUs();
+	for (int i = 0; i < threadCount; i++) {
+		this->threads.emplace_back(&DetectionScheduler::ThreadMain, this);
+	}
+}
+
+DetectionScheduler::~DetectionScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->isExiting = true;
+	}
+	this->jobQueued.notify_all();
+	for (std::thread& thread : this->threads) thread.join();
+}
+
+int DetectionScheduler::AddDevice(const std::string& name, float priority, float cpuQuota)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::unique_ptr<Device> device = std::make_unique<Device>();
+	device->name = name;
+	device->priority = priority > 0 ? priority : 1;
+	device->cpuQuota = cpuQuota;
+	// A new device starts at the current progress of the others instead of getting their whole history as credit.
+	for (const std::unique_ptr<Device>& other : this->devices) {
+		device->virtualTimeUs = std::max(device->virtualTimeUs, other->virtualTimeUs);
+	}
+	this->devices.push_back(std::move(device));
+	return (int)this->devices.size() - 1;
+}
+
+void DetectionScheduler::SetDeviceLimits(int device, float priority, float cpuQuota)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->devices[device]->priority = priority > 0 ? priority : 1;
+	this->devices[device]->cpuQuota = cpuQuota;
+}
+
+DetectionScheduler::Device* DetectionScheduler::PickDevice(int64_t nowUs)
+{
+	if (nowUs - this->windowStartUs >= quotaWindowUs) {
+		this->windowStartUs = nowUs;
+		for (const std::unique_ptr<Device>& device : this->devices) device->windowBusyUs = 0;
+	}
+	const int64_t poolUs = quotaWindowUs * (int64_t)this->threads.size();
+	Device* best = nullptr;
+	for (const std::unique_ptr<Device>& device : this->devices) {
+		if (device->pending.empty()) continue;
+		if (device->cpuQuota > 0 && device->windowBusyUs >= device->cpuQuota * poolUs) continue;
+		if (!best || device->virtualTimeUs < best->virtualTimeUs) best = device.get();
+	}
+	return best;
+}
+
+void DetectionScheduler::ThreadMain()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	while (true) {
+		Device* device = nullptr;
+		// Wakes up at least at the start of the next quota window, when throttled devices can run again.
+		this->jobQueued.wait_for(lock, std::chrono::milliseconds(10), [&] {
+			return this->isExiting || (device = this->PickDevice(LatencyTrace::NowUs()));
+			});
+		if (this->isExiting) return;
+		if (!device) continue;
+
+		Job* job = device->pending.front();
+		device->pending.erase(device->pending.begin());
+		lock.unlock();
+
+		int64_t startUs = LatencyTrace::NowUs();
+		job->func();
+		int64_t endUs = LatencyTrace::NowUs();
+
+		lock.lock();
+		device->jobs++;
+		device->windowBusyUs += endUs - startUs;
+		device->virtualTimeUs += (endUs - startUs) / device->priority;
+		device->queueLatency.Add((uint32_t)std::min<int64_t>(startUs - job->queuedUs, UINT32_MAX));
+		device->runLatency.Add((uint32_t)std::min<int64_t>(endUs - startUs, UINT32_MAX));
+		job->done = true;
+		this->jobDone.notify_all();
+	}
+}
+
+void DetectionScheduler::Run(int device, const std::function<void()>& func)
+{
+	Job job{ func, LatencyTrace::NowUs() };
+	std::unique_lock<std::mutex> lock(this->mutex);
+	Device& d = *this->devices[device];
+	if (d.pending.empty()) {
+		// Idle time is not saved up: a device coming back is not ahead of the busy ones.
+		double minActive = -1;
+		for (const std::unique_ptr<Device>& other : this->devices) {
+			if (!other->pending.empty() && (minActive < 0 || other->virtualTimeUs < minActive)) minActive = other->virtualTimeUs;
+		}
+		if (minActive > d.virtualTimeUs) d.virtualTimeUs = minActive;
+	}
+	d.pending.push_back(&job);
+	this->jobQueued.notify_one();
+	this->jobDone.wait(lock, [&] { return job.done; });
+}
+
+std::string DetectionScheduler::GetReport()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	int64_t nowUs = LatencyTrace::NowUs();
+	double seconds = std::max<int64_t>(nowUs - this->lastReportUs, 1) / 1e6;
+	this->lastReportUs = nowUs;
+
+	std::string result;
+	char line[256];
+	for (const std::unique_ptr<Device>& device : this->devices) {
+		snprintf(line, sizeof(line), "%s: %.1f detections/s, queue p50 %.1f p99 %.1f ms, detection p50 %.1f p99 %.1f ms\n",
+			device->name.c_str(), (device->jobs - device->lastReportJobs) / seconds,
+			device->queueLatency.GetPercentileMs(50), device->queueLatency.GetPercentileMs(99),
+			device->runLatency.GetPercentileMs(50), device->runLatency.GetPercentileMs(99));
+		device->lastReportJobs = device->jobs;
+		result += line;
+	}
+	return result;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "LatencyHistogram.h"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Thread pool shared by the Workers of every device in the multi-device mode.
+// Each detection is one job: the next job comes from the device with the least CPU time used relative to its priority
+// (so a busy device cannot starve the others), and a device over its CPU quota waits for the next quota window.
+class DetectionScheduler
+{
+	struct Job {
+		std::function<void()> func;
+		int64_t queuedUs;
+		bool done = false;
+	};
+	struct Device {
+		std::string name;
+		float priority; // Share of the pool relative to the other devices.
+		float cpuQuota; // Max fraction of the pool in a quota window, 0 = unlimited.
+		std::vector<Job*> pending;
+		double virtualTimeUs = 0; // Used CPU time divided by the priority.
+		int64_t windowBusyUs = 0; // CPU time used in the current quota window.
+		uint64_t jobs = 0, lastReportJobs = 0;
+		LatencyHistogram queueLatency, runLatency;
+	};
+
+	std::mutex mutex;
+	std::condition_variable jobQueued, jobDone;
+	std::vector<std::unique_ptr<Device>> devices;
+	std::vector<std::thread> threads;
+	bool isExiting = false;
+	int64_t windowStartUs, lastReportUs;
+	static const int64_t quotaWindowUs = 1000000;
+
+	Device* PickDevice(int64_t nowUs); // Called with the mutex locked.
+	void ThreadMain();
+public:
+	DetectionScheduler(int threadCount = 0); // 0 = one thread per core.
+	~DetectionScheduler();
+
+	int AddDevice(const std::string& name, float priority = 1, float cpuQuota = 0);
+	void SetDeviceLimits(int device, float priority, float cpuQuota);
+	void Run(int device, const std::function<void()>& job); // Executes the job on a pool thread, returns when it is done.
+
+	int GetThreadCount() const { return (int)this->threads.size(); }
+	std::string GetReport(); // Throughput and latency per device since the previous report.
+};
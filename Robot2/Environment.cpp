@@ -1,17 +1,35 @@
 #include "Environment.h"
+#include <algorithm>
 #pragma once
 
 Environment::Environment(Window& window, Config& config, const char* serial):
-	window(&window), config(&config), serial(serial), worker(config), scrcpy(this, this->serial), screen(nullptr), inputManager(nullptr)
+	window(&window), config(&config), serial(serial), scheduler(nullptr), schedulerDevice(-1), worker(config), scrcpy(this, this->serial), screen(nullptr), inputManager(nullptr)
 {
     Worker& worker = this->worker;
 
+    worker.SetLatencyTrace(&this->latency);
+    scrcpy.latency_trace = &this->latency;
+    scrcpy.headless = window.IsHeadless();
+    scrcpy.decoder_params.threads = config.GetDecoderThreads();
+    scrcpy.decoder_params.thread_type = config.IsDecoderFrameThreaded() ? SC_DECODER_THREAD_FRAME : SC_DECODER_THREAD_SLICE;
+    scrcpy.decoder_params.low_delay = config.IsDecoderLowDelay();
+    scrcpy.decoder_params.fast = config.IsDecoderFast();
+    scrcpy.max_fps = config.GetStreamMaxFps();
+    if (config.GetStreamBitRate() > 0) { scrcpy.bit_rate = config.GetStreamBitRate(); }
+    scrcpy.stream_scale = config.GetStreamScale();
+    scrcpy.idle_refresh_fps = std::max(0, config.GetRenderIdleFps());
+    scrcpy.upload_bands = config.IsRenderUploadBands();
+    if (config.IsFrameImageChannel()) {
+        scrcpy.frame_format = sc_frame_format_from_channel(config.GetImageChannel().c_str());
+    }
+
     scrcpy.OnWindowCreation([&](Screen* s, struct size si) {
         this->screen = s;
         s->SetWorker(&worker);
         s->SetEnvironment(this);
         worker.UpdateResolution(si.width, si.height);
-        worker.SetGrabImageFunct(s->GetGrabImageFunc());
+        worker.SetStreamScale(this->GetStreamScale());
+        worker.SetGrabImageFunct(s->GetWaitFrameFunc());
         worker.Start();
         });
     scrcpy.OnInputManCreation([&worker, this](InputManager* im) {
@@ -21,6 +39,13 @@ Environment::Environment(Window& window, Config& config, const char* serial):
         });
 }
 
+void Environment::SetScheduler(DetectionScheduler* scheduler)
+{
+    this->scheduler = scheduler;
+    this->schedulerDevice = scheduler->AddDevice(this->serial ? this->serial : "default", this->config->GetDevicePriority(), this->config->GetDeviceCpuQuota());
+    this->worker.SetScheduler(scheduler, this->schedulerDevice);
+}
+
 void Environment::SetAutomatedInputsEnabled(bool enabled)
 {
     if (this->inputManager) { this->inputManager->SetAutomatedInputsEnabled(enabled); }
@@ -28,10 +53,9 @@ void Environment::SetAutomatedInputsEnabled(bool enabled)
 
 void Environment::LoadConfig(const std::string& configFile)
 {
-    std::unique_ptr<Config> newConfig = std::make_unique<Config>();
+    std::shared_ptr<Config> newConfig = std::make_shared<Config>();
     newConfig->LoadConfig(configFile);
-    this->UpdateConfig(*newConfig.get());
-    std::swap(this->loadedConfig, newConfig);
+    this->UpdateConfig(std::move(newConfig));
 }
 
 void Environment::EnableWorker(bool enabled)
@@ -45,30 +69,31 @@ void Environment::UpdateCounterLimit(uint32_t limit)
     this->worker.GetEstimator().SetCounterLimit(limit);
 }
 
+float Environment::GetStreamScale() const
+{
+    if (!this->screen || !this->scrcpy.device_size.width) return 1;
+    const struct size& device = this->scrcpy.device_size;
+    const struct size& frame = this->screen->frame_size;
+    return (float)std::max(frame.width, frame.height) / std::max(device.width, device.height);
+}
+
 void Environment::Run()
 {
+    // The object descriptors are computed while the server starts.
+    this->worker.Prepare(this->config->GetStreamScale());
     scrcpy.Run();
+    if (this->latency.GetStage(LatencyTrace::Detect).GetCount()) {
+        printf("Latency of %s:\n%s", this->serial ? this->serial : "default", this->latency.ToString().c_str());
+    }
 }
 
-void Environment::UpdateConfig(Config& config)
+void Environment::UpdateConfig(std::shared_ptr<Config> config)
 {
-    this->config = &config;
-    if(this->screen) this->screen->SetWorker(nullptr);
-    this->worker.SetGrabImageFunct(nullptr);
-    if (this->inputManager) this->inputManager->onScreenshot = nullptr;
-
-    this->worker.~Worker();
-    Worker* w = new (&this->worker) Worker(config);
-    Worker& worker = this->worker;
-
-    if (this->screen) {
-        this->screen->SetWorker(&worker);
-        worker.UpdateResolution(this->screen->frame_size.width, this->screen->frame_size.height);
-        worker.SetGrabImageFunct(this->screen->GetGrabImageFunc());
-        worker.Start();
-    }
-    if (this->inputManager) {
-        worker.SetTouchFunct(this->inputManager->GetTouchFunc());
-        this->inputManager->onScreenshot = [&worker](int keycode) {worker.TakeScreenshot(); };
+    // The worker, its detector and the stream keep running, the worker swaps the config when its current scan is done.
+    this->config = config.get();
+    if (this->scheduler) {
+        this->scheduler->SetDeviceLimits(this->schedulerDevice, config->GetDevicePriority(), config->GetDeviceCpuQuota());
     }
+    this->worker.RequestConfig(config);
+    this->loadedConfig = std::move(config);
 }
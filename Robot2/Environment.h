@@ -9,7 +9,10 @@ class Environment {
     Window* window;
     Config* config;
     const char* serial;
-    std::unique_ptr<Config> loadedConfig;
+    std::shared_ptr<Config> loadedConfig;
+    LatencyTrace latency; // Frame to touch latency, shared by the worker and the controller.
+    DetectionScheduler* scheduler; // Multi-device mode only.
+    int schedulerDevice;
 
     Worker worker;
     scrcpyOptions scrcpy;
@@ -19,11 +22,15 @@ class Environment {
 public:
     Environment(Window& window, Config& config, const char* serial);
     void Run();
-    void UpdateConfig(Config& config);
+    void UpdateConfig(std::shared_ptr<Config> config); // The worker switches to it between two scans.
     Window* GetWindow() { return window; }
 
     void SetAutomatedInputsEnabled(bool enabled);
     void LoadConfig(const std::string& configFile);
     void EnableWorker(bool enabled);
     void UpdateCounterLimit(uint32_t limit);
+    float GetStreamScale() const; // Frame resolution relative to the device resolution.
+    LatencyTrace& GetLatency() { return this->latency; }
+    void SetScheduler(DetectionScheduler* scheduler); // Call before Run, detections of the worker then run on the shared pool.
+    const char* GetSerial() const { return this->serial; }
 };
\ No newline at end of file
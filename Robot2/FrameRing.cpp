@@ -0,0 +1,75 @@
+#include "FrameRing.h"
+#include <algorithm>
+
+FrameRing::FrameRing(int slotCount) : slotCount(std::max(2, slotCount))
+{
+}
+
+uint8_t* FrameRing::BeginWrite(int width, int height, int channels)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (width != this->width || height != this->height || channels != this->channels || this->slots.empty()) {
+		// New geometry: the old slots are dropped here and freed by their last lease.
+		this->slots.clear();
+		this->latest.reset();
+		for (int i = 0; i < this->slotCount; i++) {
+			std::shared_ptr<Slot> slot = std::make_shared<Slot>();
+			slot->data = std::make_unique<uint8_t[]>((size_t)width * height * channels);
+			slot->width = width; slot->height = height; slot->channels = channels;
+			this->slots.push_back(std::move(slot));
+		}
+		this->width = width; this->height = height; this->channels = channels;
+	}
+	this->writing.reset();
+	for (const std::shared_ptr<Slot>& slot : this->slots) {
+		// Leases are only taken under the mutex, so a free slot cannot be leased while it is written.
+		if (slot != this->latest && slot->leases == 0) {
+			this->writing = slot;
+			return slot->data.get();
+		}
+	}
+	this->droppedFrames++;
+	return nullptr;
+}
+
+void FrameRing::Publish(int64_t pts, uint32_t captureMs, const FrameTiming& timing)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->writing) return;
+	this->writing->seq = this->nextSeq++;
+	this->writing->pts = pts;
+	this->writing->captureMs = captureMs;
+	this->writing->timing = timing;
+	this->latest = std::move(this->writing);
+	this->published.notify_all();
+}
+
+void FrameRing::CancelWrite()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->writing.reset();
+}
+
+FrameRing::FrameLease FrameRing::Acquire()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->latest) return FrameLease();
+	this->latest->leases++;
+	return FrameLease(this->latest);
+}
+
+FrameRing::FrameLease FrameRing::WaitForFrame(uint64_t afterSeq, std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	if (!this->published.wait_until(lock, deadline, [&] { return this->latest && this->latest->seq > afterSeq; })) {
+		return FrameLease();
+	}
+	this->latest->leases++;
+	return FrameLease(this->latest);
+}
+
+uint64_t FrameRing::GetLatestSeq()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->latest ? this->latest->seq : 0;
+}
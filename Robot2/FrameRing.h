@@ -0,0 +1,74 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "LatencyTrace.h"
+
+// Frame buffers shared between the producer (Screen) and the consumers (Worker).
+// A consumer leases the latest published frame and can keep it for a whole detection: the producer only writes into slots nobody holds.
+class FrameRing
+{
+public:
+	class Slot {
+	public:
+		std::unique_ptr<uint8_t[]> data;
+		int width = 0, height = 0, channels = 0;
+		uint64_t seq = 0; // Publication sequence number, 0 = never published.
+		int64_t pts = -1; // Stream timestamp in microseconds, -1 = unknown.
+		uint32_t captureMs = 0; // SDL_GetTicks() at publication.
+		FrameTiming timing; // Stage timestamps until the publication.
+		std::atomic<int> leases{ 0 };
+	};
+
+	// Read access to a published frame, the slot is not rewritten until the lease is released (or destroyed).
+	class FrameLease {
+		std::shared_ptr<Slot> slot;
+	public:
+		FrameLease() = default;
+		explicit FrameLease(std::shared_ptr<Slot> slot) : slot(std::move(slot)) {}
+		FrameLease(FrameLease&& other) noexcept = default;
+		FrameLease& operator=(FrameLease&& other) noexcept { this->Release(); this->slot = std::move(other.slot); return *this; }
+		FrameLease(const FrameLease&) = delete;
+		FrameLease& operator=(const FrameLease&) = delete;
+		~FrameLease() { this->Release(); }
+
+		void Release() { if (this->slot) { this->slot->leases--; this->slot.reset(); } }
+		explicit operator bool() const { return (bool)this->slot; }
+
+		uint8_t* Data() const { return this->slot->data.get(); }
+		int Width() const { return this->slot->width; }
+		int Height() const { return this->slot->height; }
+		int Channels() const { return this->slot->channels; }
+		uint64_t Seq() const { return this->slot->seq; }
+		int64_t Pts() const { return this->slot->pts; }
+		uint32_t CaptureMs() const { return this->slot->captureMs; }
+		const FrameTiming& Timing() const { return this->slot->timing; }
+	};
+private:
+	std::mutex mutex;
+	std::condition_variable published;
+	std::vector<std::shared_ptr<Slot>> slots;
+	std::shared_ptr<Slot> latest, writing;
+	uint64_t nextSeq = 1;
+	int slotCount;
+	int width = 0, height = 0, channels = 0;
+	size_t droppedFrames = 0;
+public:
+	FrameRing(int slotCount = 4);
+
+	// Buffer of a slot which is neither leased nor the latest frame, nullptr if every slot is held.
+	// The slots are (re)allocated when the frame geometry changes, leased old slots stay valid until released.
+	uint8_t* BeginWrite(int width, int height, int channels);
+	void Publish(int64_t pts, uint32_t captureMs, const FrameTiming& timing); // Makes the frame written since BeginWrite the latest one.
+	void CancelWrite();
+
+	FrameLease Acquire(); // Lease on the latest frame, empty if nothing was published yet.
+	// Blocks until a frame newer than afterSeq is published, empty if the deadline passes first.
+	FrameLease WaitForFrame(uint64_t afterSeq, std::chrono::steady_clock::time_point deadline);
+	uint64_t GetLatestSeq();
+	size_t GetDroppedFrames() const { return this->droppedFrames; } // Frames lost because every slot was held.
+};
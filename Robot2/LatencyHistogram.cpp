@@ -0,0 +1,74 @@
+#include "LatencyHistogram.h"
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram()
+{
+	this->Reset();
+}
+
+int LatencyHistogram::BucketOf(uint32_t us)
+{
+	if (us < 16) return us;
+	int exp = 31;
+	while (!(us >> exp)) exp--;
+	int sub = (us >> (exp - 2)) & 3;
+	return 16 + (exp - 4) * 4 + sub;
+}
+
+uint32_t LatencyHistogram::BucketUpperUs(int bucket)
+{
+	if (bucket < 16) return bucket;
+	int exp = (bucket - 16) / 4 + 4;
+	int sub = (bucket - 16) % 4;
+	uint64_t upper = ((uint64_t)(4 + sub + 1) << (exp - 2)) - 1;
+	return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
+
+void LatencyHistogram::Add(uint32_t us)
+{
+	this->buckets[BucketOf(us)]++;
+	this->count++;
+	this->sumUs += us;
+	uint32_t prevMax = this->maxUs;
+	while (us > prevMax && !this->maxUs.compare_exchange_weak(prevMax, us));
+}
+
+void LatencyHistogram::Reset()
+{
+	for (std::atomic<uint32_t>& bucket : this->buckets) bucket = 0;
+	this->count = 0;
+	this->sumUs = 0;
+	this->maxUs = 0;
+}
+
+double LatencyHistogram::GetMeanMs() const
+{
+	uint64_t n = this->count;
+	return n ? this->sumUs / 1000.0 / n : 0;
+}
+
+double LatencyHistogram::GetPercentileMs(double percentile) const
+{
+	uint64_t n = this->count;
+	if (!n) return 0;
+	uint64_t target = (uint64_t)(percentile / 100.0 * n);
+	if (target >= n) target = n - 1;
+	uint64_t seen = 0;
+	for (int i = 0; i < bucketCount; i++) {
+		seen += this->buckets[i];
+		if (seen > target) {
+			uint32_t upper = BucketUpperUs(i);
+			return (upper < this->maxUs ? upper : (uint32_t)this->maxUs) / 1000.0;
+		}
+	}
+	return this->GetMaxMs();
+}
+
+std::string LatencyHistogram::ToString() const
+{
+	char text[160];
+	snprintf(text, sizeof(text), "n=%llu avg %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f ms",
+		(unsigned long long)this->GetCount(), this->GetMeanMs(),
+		this->GetPercentileMs(50), this->GetPercentileMs(90), this->GetPercentileMs(99), this->GetMaxMs());
+	return text;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Log-linear histogram of durations in microseconds (4 buckets per power of two, ~19% resolution).
+// Add can be called from one thread while others read the statistics.
+class LatencyHistogram
+{
+	static const int bucketCount = 128;
+	std::atomic<uint32_t> buckets[bucketCount];
+	std::atomic<uint64_t> count, sumUs;
+	std::atomic<uint32_t> maxUs;
+
+	static int BucketOf(uint32_t us);
+	static uint32_t BucketUpperUs(int bucket);
+public:
+	LatencyHistogram();
+
+	void Add(uint32_t us);
+	void AddMs(uint32_t ms) { this->Add(ms * 1000); }
+	void Reset();
+
+	uint64_t GetCount() const { return this->count; }
+	double GetMeanMs() const;
+	double GetMaxMs() const { return this->maxUs / 1000.0; }
+	double GetPercentileMs(double percentile) const; // Upper bound of the bucket holding the percentile, 0 if empty.
+	std::string ToString() const; // "n=.. avg .. p50 .. p90 .. p99 .. max .. ms"
+};
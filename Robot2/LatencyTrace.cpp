@@ -0,0 +1,62 @@
+#include "LatencyTrace.h"
+#include <algorithm>
+#include <chrono>
+
+int64_t LatencyTrace::NowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* LatencyTrace::GetStageName(Stage stage)
+{
+	static const char* names[StageCount] = { "decode", "convert", "queue", "detect", "act", "serialize", "send", "total" };
+	return names[stage];
+}
+
+void LatencyTrace::AddStage(Stage stage, int64_t fromUs, int64_t toUs)
+{
+	if (!fromUs || !toUs || toUs < fromUs) return;
+	this->stages[stage].Add((uint32_t)std::min<int64_t>(toUs - fromUs, UINT32_MAX));
+}
+
+void LatencyTrace::AddFrame(const FrameTiming& timing)
+{
+	this->AddStage(Decode, timing.receiveUs, timing.decodedUs);
+	this->AddStage(Convert, timing.decodedUs, timing.convertedUs);
+	this->AddStage(Queue, timing.convertedUs, timing.detectStartUs);
+	this->AddStage(Detect, timing.detectStartUs, timing.detectEndUs);
+}
+
+void LatencyTrace::AddInput(const FrameTiming& timing)
+{
+	this->AddStage(Act, timing.detectEndUs, timing.actionUs);
+	this->AddStage(Serialize, timing.actionUs, timing.serializedUs);
+	this->AddStage(Send, timing.serializedUs, timing.sentUs);
+	this->AddStage(Total, timing.receiveUs, timing.sentUs);
+	if (timing.actionInd < 0 || !timing.receiveUs || timing.sentUs < timing.receiveUs) return;
+
+	std::lock_guard<std::mutex> lock(this->actionsMutex);
+	std::unique_ptr<LatencyHistogram>& histogram = this->actions[timing.actionInd];
+	if (!histogram) histogram = std::make_unique<LatencyHistogram>();
+	histogram->Add((uint32_t)std::min<int64_t>(timing.sentUs - timing.receiveUs, UINT32_MAX));
+}
+
+void LatencyTrace::Reset()
+{
+	for (LatencyHistogram& stage : this->stages) stage.Reset();
+	std::lock_guard<std::mutex> lock(this->actionsMutex);
+	this->actions.clear();
+}
+
+std::string LatencyTrace::ToString()
+{
+	std::string result;
+	for (int i = 0; i < StageCount; i++) {
+		result += std::string(GetStageName((Stage)i)) + ": " + this->stages[i].ToString() + '\n';
+	}
+	std::lock_guard<std::mutex> lock(this->actionsMutex);
+	for (const auto& action : this->actions) {
+		result += "action " + std::to_string(action.first) + ": " + action.second->ToString() + '\n';
+	}
+	return result;
+}
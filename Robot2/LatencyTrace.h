@@ -0,0 +1,43 @@
+#pragma once
+#include "LatencyHistogram.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Timestamps (LatencyTrace::NowUs, 0 = not reached) of a frame on its way from the socket to the touch it caused.
+struct FrameTiming
+{
+	int64_t receiveUs = 0; // Packet header read from the video socket.
+	int64_t decodedUs = 0; // Frame returned by the decoder.
+	int64_t convertedUs = 0; // Frame converted and published for the worker.
+	int64_t detectStartUs = 0, detectEndUs = 0;
+	int64_t actionUs = 0; // Action fired based on the detection.
+	int64_t serializedUs = 0; // Control message serialized by the controller thread.
+	int64_t sentUs = 0; // Control message written to the socket.
+	int actionInd = -1;
+};
+
+// Latency distribution of every stage between two consecutive FrameTiming timestamps, and of the whole path per action.
+class LatencyTrace
+{
+public:
+	enum Stage { Decode, Convert, Queue, Detect, Act, Serialize, Send, Total, StageCount };
+private:
+	LatencyHistogram stages[StageCount];
+	std::mutex actionsMutex;
+	std::map<int, std::unique_ptr<LatencyHistogram>> actions; // Total latency by action index.
+
+	void AddStage(Stage stage, int64_t fromUs, int64_t toUs);
+public:
+	static int64_t NowUs(); // Monotonic clock shared by every stage.
+	static const char* GetStageName(Stage stage);
+
+	void AddFrame(const FrameTiming& timing); // Records the stages until the end of the detection.
+	void AddInput(const FrameTiming& timing); // Records the stages from the action to the socket write and the total.
+	void Reset();
+
+	const LatencyHistogram& GetStage(Stage stage) const { return this->stages[stage]; }
+	std::string ToString(); // One line per stage and per action.
+};
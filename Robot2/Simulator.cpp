@@ -0,0 +1,119 @@
+#include "Simulator.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace fs = std::filesystem;
+
+static bool IsImageFile(const fs::path& path)
+{
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+	return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp";
+}
+
+Simulator::Simulator(Config& config, const std::string& framesDir) : config(config), worker(config), frames(2), lastGrabUs(0), computeUs(0), frameCount(0), clickCount(0)
+{
+	if (!fs::is_directory(framesDir)) { return; }
+	for (const fs::directory_entry& entry : fs::directory_iterator(framesDir)) {
+		if (entry.is_regular_file() && IsImageFile(entry.path())) { this->framePaths[""].push_back(entry.path()); }
+		if (entry.is_directory()) {
+			const std::string stateName = entry.path().filename().string();
+			for (const fs::directory_entry& stateEntry : fs::directory_iterator(entry.path())) {
+				if (stateEntry.is_regular_file() && IsImageFile(stateEntry.path())) { this->framePaths[stateName].push_back(stateEntry.path()); }
+			}
+		}
+	}
+	for (auto& [state, paths] : this->framePaths) { std::sort(paths.begin(), paths.end()); }
+}
+
+const cv::Mat& Simulator::LoadImage(const fs::path& path)
+{
+	auto it = this->images.find(path);
+	if (it != this->images.end()) { return it->second; }
+	cv::Mat image = cv::imread(path.string());
+	if (image.empty()) { std::cout << "Cannot read frame " << path << ".\n"; }
+	else if (image.size() != this->frameSize) { cv::resize(image, image, this->frameSize); } // Every frame gets the resolution of the first one.
+	return this->images.emplace(path, std::move(image)).first->second;
+}
+
+FrameRing::FrameLease Simulator::GrabFrame()
+{
+	// The detection and action evaluation since the last grab took real time on the device too.
+	const int64_t nowUs = LatencyTrace::NowUs();
+	if (this->lastGrabUs) {
+		this->computeUs += nowUs - this->lastGrabUs;
+		this->clock.Advance((uint32_t)(this->computeUs / 1000));
+		this->computeUs %= 1000;
+	}
+
+	auto pathsIt = this->framePaths.find(this->worker.GetState()->name);
+	if (pathsIt == this->framePaths.end() || pathsIt->second.empty()) { pathsIt = this->framePaths.find(""); }
+	FrameRing::FrameLease lease;
+	if (pathsIt != this->framePaths.end() && !pathsIt->second.empty()) {
+		size_t& next = this->nextFrame[pathsIt->first];
+		const cv::Mat& image = this->LoadImage(pathsIt->second[next++ % pathsIt->second.size()]);
+		uint8_t* data = image.empty() ? nullptr : this->frames.BeginWrite(image.cols, image.rows, image.channels());
+		if (data) {
+			image.copyTo(cv::Mat(image.rows, image.cols, image.type(), data));
+			FrameTiming timing;
+			timing.convertedUs = LatencyTrace::NowUs();
+			this->frames.Publish(-1, this->clock.NowMs(), timing);
+			this->frameCount++;
+		}
+		lease = this->frames.Acquire();
+	}
+	this->lastGrabUs = LatencyTrace::NowUs();
+	return lease;
+}
+
+bool Simulator::Run(double hours)
+{
+	const fs::path* firstPath = nullptr;
+	for (const auto& [state, paths] : this->framePaths) {
+		if (!paths.empty()) { firstPath = &paths.front(); break; }
+	}
+	if (!firstPath) {
+		std::cout << "No frames found for the simulation.\n";
+		return false;
+	}
+	cv::Mat first = cv::imread(firstPath->string());
+	if (first.empty()) {
+		std::cout << "Cannot read frame " << *firstPath << ".\n";
+		return false;
+	}
+	this->frameSize = first.size();
+	std::cout << "Simulating " << hours << " hours on " << this->frameSize.width << 'x' << this->frameSize.height << " frames.\n";
+
+	this->worker.SetClock(&this->clock);
+	this->worker.SetStreamScale(this->config.GetStreamScale());
+	this->worker.UpdateResolution(this->frameSize.width, this->frameSize.height);
+	this->worker.SetGrabImageFunct([this](uint64_t, uint32_t) { return this->GrabFrame(); });
+	this->worker.SetTouchFunct([this](int, int, bool isDown, const FrameTiming*) { if (isDown) this->clickCount++; });
+
+	const uint32_t endMs = (uint32_t)(hours * 3600000);
+	const auto wallStart = std::chrono::steady_clock::now();
+	auto lastReport = wallStart;
+	auto report = [&] {
+		const double wallMinutes = std::chrono::duration<double, std::ratio<60>>(std::chrono::steady_clock::now() - wallStart).count();
+		const double simHours = this->clock.NowMs() / 3600000.0;
+		std::cout << std::fixed << std::setprecision(2) << "Simulated " << simHours << " h in " << wallMinutes * 60 << " s ("
+			<< (wallMinutes > 0 ? simHours / wallMinutes : 0) << " simulated hours per minute), " << this->frameCount << " frames, " << this->clickCount << " clicks.\n";
+	};
+	this->worker.Start();
+	while (this->worker.IsRunning() && this->clock.NowMs() < endMs) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if (std::chrono::steady_clock::now() - lastReport >= std::chrono::seconds(10)) {
+			lastReport = std::chrono::steady_clock::now();
+			report();
+		}
+	}
+	this->worker.Stop(true);
+	while (this->worker.IsRunning()) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); } // Stopped by the counter limit (detached).
+	report();
+	return true;
+}
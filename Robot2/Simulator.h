@@ -0,0 +1,34 @@
+#pragma once
+#include "Config.h"
+#include "Worker.h"
+#include "Clock.h"
+#include "FrameRing.h"
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Runs a config's state machine on recorded frames in virtual time (started with the --simulate command line argument).
+// Each scan gets the next frame of <frames dir>/<current state name>/, or of <frames dir>/ if the state has no directory, in file name order and repeated.
+// The virtual time passes with the waits of the worker and with the real time of the detections, so it runs as fast as the detection allows.
+class Simulator
+{
+	Config& config;
+	VirtualClock clock;
+	Worker worker;
+	FrameRing frames;
+	std::map<std::string, std::vector<std::filesystem::path>> framePaths; // By state name, "" = the frames directory itself.
+	std::map<std::string, size_t> nextFrame;
+	std::map<std::filesystem::path, cv::Mat> images; // Decoded frames.
+	cv::Size frameSize;
+	int64_t lastGrabUs, computeUs; // Real time spent since the last grab, added to the virtual clock.
+	size_t frameCount, clickCount;
+
+	const cv::Mat& LoadImage(const std::filesystem::path& path);
+	FrameRing::FrameLease GrabFrame();
+public:
+	Simulator(Config& config, const std::string& framesDir);
+
+	bool Run(double hours); // False if there are no frames.
+};
@@ -0,0 +1,45 @@
+#include "TaskScheduler.h"
+
+uint64_t TaskScheduler::Schedule(uint32_t dueMs, std::function<void()> step)
+{
+	const uint64_t id = this->nextId++;
+	this->steps.emplace(std::make_pair(dueMs, id), std::move(step));
+	return id;
+}
+
+bool TaskScheduler::Cancel(uint64_t id)
+{
+	for (auto it = this->steps.begin(); it != this->steps.end(); ++it) {
+		if (it->first.second == id) { this->steps.erase(it); return true; }
+	}
+	return false;
+}
+
+int TaskScheduler::RunDue(uint32_t nowMs)
+{
+	int count = 0;
+	while (!this->steps.empty() && this->steps.begin()->first.first <= nowMs) {
+		// Removed before running, so the step can schedule or cancel others.
+		std::function<void()> step = std::move(this->steps.begin()->second);
+		this->steps.erase(this->steps.begin());
+		step();
+		count++;
+	}
+	return count;
+}
+
+void TaskScheduler::Flush()
+{
+	while (!this->steps.empty()) {
+		std::function<void()> step = std::move(this->steps.begin()->second);
+		this->steps.erase(this->steps.begin());
+		step();
+	}
+}
+
+bool TaskScheduler::GetNextDue(uint32_t& dueMs) const
+{
+	if (this->steps.empty()) return false;
+	dueMs = this->steps.begin()->first.first;
+	return true;
+}
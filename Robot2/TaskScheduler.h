@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <utility>
+
+// Timed steps of the Worker's tasks (touch releases, the continuation of an action after a wait), run on the Worker thread.
+// The time is given by the caller, steps due at the same time run in the order they were scheduled, so a run only depends on the clock it is fed.
+class TaskScheduler
+{
+	std::map<std::pair<uint32_t, uint64_t>, std::function<void()>> steps; // (due time, id) -> step.
+	uint64_t nextId = 1;
+public:
+	uint64_t Schedule(uint32_t dueMs, std::function<void()> step); // Returns the id of the step, never 0.
+	bool Cancel(uint64_t id);
+	int RunDue(uint32_t nowMs); // Runs the steps due until nowMs (including the ones they schedule), returns their count.
+	void Flush(); // Runs every remaining step immediately, in order.
+	bool GetNextDue(uint32_t& dueMs) const; // False if nothing is scheduled.
+	bool IsEmpty() const { return this->steps.empty(); }
+};
@@ -1,58 +1,51 @@
 #pragma once
+#include <atomic>
 #include <mutex>
+#include <functional>
 
-template <typename BufferType>
-class LockedBuffer {
-	std::unique_lock<std::mutex> lock;
-	BufferType& ref;
-public:
-	LockedBuffer(BufferType& wi, std::unique_lock<std::mutex>&& lock) : ref(wi), lock(std::move(lock)) {}
-	BufferType& Get() { return ref; }
-};
-
+// Lock-free triple buffer between one writer and one reader thread.
+// The writer fills the live buffer and commits it by swapping its index with the middle one, the reader swaps the middle buffer in when it is newer.
+// Commits never copy the buffers: the new live buffer holds an older state, BufferType::CarryOver(committed) can bring it up to date (if defined).
 template <typename BufferType>
 class ThreadSafeBuffer
 {
+	static constexpr int indexMask = 3, freshBit = 4; // freshBit: the middle buffer was committed after the reader's last swap.
 	BufferType buffer[3];
-	BufferType* live, *last, *waitingToBeLast;
-	bool waitingToBeLastValid, isLiveDirty;
-	std::mutex lastMutex, waitingMutex;
+	int live, last; // Owned by the writer and the reader.
+	std::atomic<int> middle;
+	bool isLiveDirty;
+	std::function<void()> onCommit; // Called by the committing thread after each commit.
+	std::mutex onCommitMutex;
 public:
-	ThreadSafeBuffer(): buffer(), live(buffer+0), last(buffer+1), waitingToBeLast(buffer+2), waitingToBeLastValid(false), isLiveDirty(false){}
-	
-	BufferType& GetLive() { isLiveDirty = true; return *live; }
-	
-	LockedBuffer<BufferType> GetLast()
+	ThreadSafeBuffer(): buffer(), live(0), last(1), middle(2), isLiveDirty(false){}
+
+	BufferType& GetLive(bool markDirty = true) { isLiveDirty |= markDirty; return buffer[live]; }
+
+	// The last committed buffer, valid until the next GetLast call (single reader).
+	const BufferType& GetLast()
 	{
-		if (waitingToBeLastValid) {
-			std::lock_guard<std::mutex> lock(waitingMutex);
-			if (waitingToBeLastValid) {
-				std::swap(waitingToBeLast, last);
-				waitingToBeLastValid = false;
-			}
+		if (middle.load(std::memory_order_acquire) & freshBit) {
+			last = middle.exchange(last, std::memory_order_acq_rel) & indexMask;
 		}
-		std::unique_lock<std::mutex> lock(this->lastMutex);
-		LockedBuffer<BufferType> result(*last, std::move(lock));
-		return result;
+		return buffer[last];
 	}
 	void Commit()
 	{
 		if (!isLiveDirty) return;
 
-		if (lastMutex.try_lock())
-		{
-			//std::swap(live, last);
-			*last = *live; // copy
-			waitingToBeLastValid = false;
-			lastMutex.unlock();
-		}
-		else
-		{
-			std::lock_guard<std::mutex> lock(waitingMutex);
-			//std::swap(live, waitingToBeLast);
-			*waitingToBeLast = *live;
-			waitingToBeLastValid = true;
+		const int committed = live;
+		live = middle.exchange(committed | freshBit, std::memory_order_acq_rel) & indexMask;
+		if constexpr (requires(BufferType& b, const BufferType& c) { b.CarryOver(c); }) {
+			buffer[live].CarryOver(buffer[committed]); // The reader only reads the committed buffer meanwhile.
 		}
 		isLiveDirty = false;
+
+		std::lock_guard<std::mutex> lock(onCommitMutex);
+		if (onCommit) onCommit();
 	}
-};
\ No newline at end of file
+	void SetOnCommit(const std::function<void()>& f)
+	{
+		std::lock_guard<std::mutex> lock(onCommitMutex);
+		onCommit = f;
+	}
+};
@@ -1,11 +1,16 @@
 #include "Window.h"
 #include "scrcpy/scrcpy.h"
 
-Window::Window() :
-    window(Window::_CreateWindow()),
-    console(*window)
+Window::Window(bool headless) :
+    window(headless ? nullptr : Window::_CreateWindow()),
+    console(window)
 {
-    console.Init();
+    if (headless) {
+        Window::InitSDL(false);
+    }
+    else {
+        console.Init();
+    }
 }
 
 Window::~Window()
@@ -49,17 +54,17 @@ void Window::GetClientSize(int* w, int* h)
 
 SDL_Window* Window::_CreateWindow()
 {
-    Window::InitSDL();
+    Window::InitSDL(true);
     int x = SDL_WINDOWPOS_UNDEFINED;
     int y = SDL_WINDOWPOS_UNDEFINED;
     SDL_Window* w = SDL_CreateWindow("Main window", x, y, 600, 800, SDL_WINDOW_OPENGL);
     return w;
 }
 
-void Window::InitSDL()
+void Window::InitSDL(bool display)
 {
     if (Window::sdl_initialized) return;
     SDL_SetMainReady();
-    scrcpyOptions::sdl_init_and_configure(true, nullptr, false);
+    scrcpyOptions::sdl_init_and_configure(display, nullptr, false);
     Window::sdl_initialized = true;
 }
@@ -9,16 +9,18 @@ class Environment;
 class Window {
 	inline static bool sdl_initialized = false;
 	static SDL_Window* _CreateWindow();
-	static void InitSDL();
+	static void InitSDL(bool display);
 
 protected:
 	SDL_Window* window;
 	GLConsole console;
 	Environment* environment;
 public:
-	Window();
+	Window(bool headless = false); // Headless windows have no SDL window, GL context and console.
 	virtual ~Window();
 
+	bool IsHeadless() const { return !this->window; }
+
 	bool ManageConsoleKey(SDL_Keycode keycode, SDL_Scancode scancode, uint16_t mod, bool isDown);
 
 	void Render();
@@ -2,117 +2,146 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <chrono>
+#include <cmath>
+#include <algorithm>
 #include <SDL2/SDL_timer.h>
 #include <iostream>
 
 FixedResolutionConfig::FixedResolutionConfig(const Config& config, int width, int height):width(width), height(height)
 {
-	this->screenMasksPerState.resize(config.GetStates().size());
-	int stateInd = -1;
-	for (const Config::State& state : config.GetStates())
+	const DecisionTable& table = config.GetDecisionTable();
+	this->requirementScanRects = table.ComputeScanRects(cv::Size(width, height));
+	this->screenMasksPerState.resize(table.GetStateCount());
+	this->objectScanRectsPerState.resize(table.GetStateCount(), std::vector<cv::Rect>(config.GetObjectCount()));
+	for (int stateInd = 0; stateInd < table.GetStateCount(); stateInd++)
 	{
-		stateInd++;
 		cv::Mat& mask = this->screenMasksPerState[stateInd];
 		mask = cv::Mat::zeros(height, width, CV_8U);
 
-		for (int actionInd : state.actionInds)
+		for (uint32_t actionInd : table.GetStateActions(stateInd))
 		{
-			const Config::Action& action = config.GetActions()[actionInd];
-			
-			for (const std::unique_ptr<Config::Requirement>& requirement : action.requirements)
+			const uint32_t firstReq = table.GetFirstRequirement(actionInd);
+			for (uint32_t reqInd = firstReq; reqInd < firstReq + table.GetRequirementCount(actionInd); reqInd++)
 			{
-				Config::Requirement* reqPtr = requirement.get();
-				Config::ObjectRequirement* objReq = dynamic_cast<Config::ObjectRequirement*>(reqPtr);
-				if (objReq) {
-					cv::Rect rect(objReq->CalculateScanRect(cv::Size(width, height)));
-					// add region to mask.
-					cv::rectangle(mask, rect, cv::Scalar_<uint8_t>(255), cv::LineTypes::FILLED);
-					char n = mask.at<char>(0, 0);
-					char p = mask.at<char>(90, 90);
-					int a = 0;
-				}
+				const DecisionTable::Requirement& req = table.GetRequirement(reqInd);
+				if (req.type != DecisionTable::Requirement::Type::Object) continue;
+				const cv::Rect& rect = this->requirementScanRects[reqInd];
+				this->objectScanRectsPerState[stateInd][req.objInd] |= rect;
+				// add region to mask.
+				cv::rectangle(mask, rect, cv::Scalar_<uint8_t>(255), cv::LineTypes::FILLED);
 			}
 			
-			//cv::imwrite(std::format("mask_{}.png", state.name), mask);
+			//cv::imwrite(std::format("mask_{}.png", config.GetStates()[stateInd].name), mask);
 		}
 	}
 }
 
 void Worker::Run()
 {
-	using namespace std::chrono_literals;
-	
-	cv::setNumThreads(config.GetThreadCount());
+	if (!this->scheduler) cv::setNumThreads(this->config->GetThreadCount()); // Global setting, the scheduler's pool sets the parallelism instead.
 
-	ObjDetect od = config.CreateDetector();
+	// The prepared detector only fits if the stream got the expected resolution.
+	ObjDetect od = (this->preparedDetector.valid() && std::abs(this->preparedScale - this->streamScale) < 0.01f) ?
+		this->preparedDetector.get() : this->config->CreateDetector(this->streamScale);
 	try {
 	while (!isExiting)
 	{
 		if (!grabImageFunc || !this->frConfig.get()) {
-			std::this_thread::sleep_for(100ms);
+			this->clock->SleepMs(100);
 			continue;
 		}
+		{
+			std::unique_lock<std::mutex> lock(this->pendingConfigMutex);
+			if (this->pendingConfig) {
+				std::shared_ptr<Config> newConfig = std::move(this->pendingConfig);
+				lock.unlock();
+				this->ApplyConfig(std::move(newConfig), od);
+			}
+		}
 
 		{
 			//printf("screen proc<<");
-			//std::tuple<uint8_t*, std::unique_lock<std::mutex>> imageBuf = grabImageFunc();
-			//uint8_t* imageRawPtr = std::get<0>(imageBuf);
-			uint8_t* imageRawPtr = grabImageFunc();
-			if (!imageRawPtr) continue;
+			// Wait for a frame newer than the last one once every due object of the state was detected on it,
+			// a state change or an object becoming due (or skipped by scan_object_limit) makes the last frame worth detecting again.
+			// The wait is bounded so time based requirements are still evaluated on a static screen.
+			// The lease keeps the frame from being overwritten until the detection is done.
+			const bool isFrameDone = this->currentState == this->lastFrameState && !this->takeScreenshot && !this->HasDueObjects(this->clock->NowMs(), this->lastFrameSeq);
+			const uint64_t afterSeq = isFrameDone ? this->lastFrameSeq : 0;
+			FrameRing::FrameLease frame = grabImageFunc(afterSeq, this->LimitWaitToNextStep(100));
+			if (frame) {
+				this->lastFrameSeq = frame.Seq();
+				this->lastFrameState = this->currentState;
+			}
+			else if (isFrameDone && this->currentState->hasObjectToDetect) {
+				this->SelectObjectsToScan(this->clock->NowMs(), this->lastFrameSeq); // No newer frame, the last results are refreshed.
+			}
 
 			// Convert image to single channel.
 			// Object detection based on current state and config +mask.
-			if (this->currentState->hasObjectToDetect) {
-				this->lastDetectionMs = SDL_GetTicks();
-				od.UpdateBaseImage(cv::Mat(this->frConfig->GetHeight(), this->frConfig->GetWidth(), CV_8UC4, imageRawPtr));
-				this->lastDetection = od.FindObjects(&this->currentState->objectsToDetect);
+			if (frame && this->currentState->hasObjectToDetect) {
+				this->lastDetectionMs = this->clock->NowMs(); // A scan without due objects waits scan_wait_ms too.
+			}
+			if (frame && this->currentState->hasObjectToDetect && (this->SelectObjectsToScan(this->lastDetectionMs, frame.Seq()) || this->takeScreenshot)) {
+				FrameTiming timing = frame.Timing();
+				timing.detectStartUs = LatencyTrace::NowUs();
+				cv::Mat image(frame.Height(), frame.Width(), CV_8UC(frame.Channels()), frame.Data());
+				const int stateInd = this->currentState - &this->config->GetStates()[0];
+				auto detect = [&] {
+					od.UpdateBaseImage(image);
+					std::vector<std::vector<RectProb>> result = od.FindObjects(&this->objectsToScan, &this->frConfig->GetObjectScanRects(stateInd));
+					for (size_t i = 0; i < result.size(); i++) {
+						if (this->objectsToScan[i]) { this->lastDetection[i] = std::move(result[i]); this->objectScanMs[i] = this->objectResultMs[i] = this->lastDetectionMs; this->objectFrameSeq[i] = frame.Seq(); }
+						else if (!this->currentState->objectsToDetect[i]) { this->lastDetection[i].clear(); this->objectScanMs[i] = this->objectResultMs[i] = -1; this->objectFrameSeq[i] = 0; }
+						else { for (RectProb& r : this->lastDetection[i]) { r.isExcluded = false; } } // Kept result, evaluated again.
+					}
+				};
+				if (this->scheduler) this->scheduler->Run(this->schedulerDevice, detect);
+				else detect();
+				this->colorSkipsPerState[stateInd] += od.GetSkippedObjectCount();
 				if (this->takeScreenshot) {
-					cv::imwrite("screenshot.png", cv::Mat(this->frConfig->GetHeight(), this->frConfig->GetWidth(), CV_8UC4, imageRawPtr));
+					cv::imwrite("screenshot.png", image);
 					od.SaveBaseImage("screenshot-1ch.png");
 					this->takeScreenshot = false;
 					std::cout << "Taking screenshot.\n";
 				}
-				this->workerInfos.GetLive().SetDetections(this->lastDetection);
-				this->workerInfos.Commit();
+				this->detectionVersion++;
+				this->CommitInfos();
 				std::cout << "State: " << this->currentState->name <<" d:[";
 				for (int i = 0; i < this->lastDetection.size(); i++) {
 					if(this->currentState->objectsToDetect[i])
-						std::cout << this->config.GetObjects()[i].second << ':' << this->lastDetection[i].size() << ", ";
+						std::cout << this->config->GetObjects()[i].second << ':' << this->lastDetection[i].size() << ", ";
 				}
-				std::cout << "]\n";
+				std::cout << ']';
+				std::cout << '\n';
 				od.UpdateBaseImage(cv::Mat());
-			}
-			//printf("screen processing done\n");
-		}
-		this->nowMs = SDL_GetTicks();
-		// Evaluate actions.
-		for (int aInd : this->currentState->actionInds)
-		{
-			const Config::Action& action = this->config.GetActions()[aInd];
-			bool allReqGood = true;
-			for (const std::unique_ptr<Config::Requirement>& req : action.requirements)
-			{
-				if (!req->IsSatisfied(this)) { 
-					allReqGood = false;
-					break; 
+				timing.detectEndUs = LatencyTrace::NowUs();
+				this->detectionTiming = timing;
+				if (this->latencyTrace) this->latencyTrace->AddFrame(timing);
+				if (timing.convertedUs) {
+					this->frameLatency.Add((uint32_t)(timing.detectEndUs - timing.convertedUs));
+					if (this->frameLatency.GetCount() % 64 == 0) {
+						std::cout << "Frame to detection latency: " << this->frameLatency.ToString() << '\n';
+					}
+				}
+				if (this->detectionVersion % 64 == 0 && this->colorSkipsPerState[stateInd]) {
+					std::cout << "Objects skipped by the colour prefilter in state " << this->currentState->name << ": " << this->colorSkipsPerState[stateInd] << '\n';
 				}
 			}
-			if (!allReqGood) continue;
-			this->lastActionMs = nowMs;
-			// Do the action's tasks.
-			for (const std::unique_ptr<Config::Task>& task : action.tasks)
-			{
-				task->Execute(*this);
-			}
-
+			//printf("screen processing done\n");
 		}
-		this->GetInfos().Commit();
+		this->UpdateNow();
+		// A resumed action continues its evaluation pass, a new pass starts on the next scan.
+		const bool wasWaiting = this->resumeStepId != 0;
+		this->taskScheduler.RunDue(this->nowMs);
+		if (!wasWaiting) this->EvaluateActions();
+		this->CommitInfos();
 
-		uint32_t timeSinceLastDetectionMs = SDL_GetTicks() - this->lastDetectionMs;
-		if (timeSinceLastDetectionMs < config.GetScanWaitMs()) {
-			int sleepTimeMs = config.GetScanWaitMs() - timeSinceLastDetectionMs;
-			printf("Sleeping for %d ms\n", sleepTimeMs);
-			std::this_thread::sleep_for(std::chrono::milliseconds(sleepTimeMs));
+		// The randomized wait is read once, both the check and the sleep use the same value.
+		const int64_t scanWaitMs = this->config->GetScanWaitMs();
+		const int64_t remainingWaitMs = scanWaitMs - (uint32_t)(this->clock->NowMs() - this->lastDetectionMs);
+		if (remainingWaitMs > 0) {
+			const uint32_t sleepTimeMs = this->LimitWaitToNextStep((uint32_t)remainingWaitMs);
+			if (sleepTimeMs) this->clock->SleepMs(sleepTimeMs);
 		}
 	}
 
@@ -123,12 +152,127 @@ void Worker::Run()
 	catch (...) {
 		printf("??? exception\n");
 	}
+	// The pending touch releases are sent now, the waiting action is dropped.
+	this->CancelActionEvaluation();
+	this->taskScheduler.Flush();
+	if (this->frameLatency.GetCount()) {
+		std::cout << "Frame to detection latency: " << this->frameLatency.ToString() << '\n';
+	}
 	printf("Thread exiting\n");
+	this->isRunning = false;
+}
+
+void Worker::EvaluateActions()
+{
+	// The actions of the state at the start of the pass are evaluated, even if a task changes the state.
+	const DecisionTable& table = this->config->GetDecisionTable();
+	DecisionTable::Context context{ this->nowMs, this->lastActionMs, &this->lastDetection, &this->frConfig->GetRequirementScanRects(), &this->objectResultMs };
+	if (this->evalStateInd < 0) {
+		this->evalStateInd = this->currentState - &this->config->GetStates()[0];
+		this->evalPos = 0;
+	}
+	while (true)
+	{
+		if (this->evalActionInd < 0) {
+			this->evalActionInd = table.FindSatisfiedAction(this->evalStateInd, this->evalPos, context);
+			if (this->evalActionInd < 0) break;
+			this->lastActionMs = nowMs;
+			this->actionTiming = this->detectionTiming;
+			this->actionTiming.actionUs = LatencyTrace::NowUs();
+			this->actionTiming.actionInd = this->evalActionInd;
+			this->evalNextTask = 0;
+		}
+		// Do the action's tasks.
+		const Config::Action& action = this->config->GetActions()[this->evalActionInd];
+		while (this->evalNextTask < action.tasks.size())
+		{
+			uint32_t waitMs = action.tasks[this->evalNextTask++]->Execute(*this);
+			if (waitMs) {
+				this->resumeStepId = this->taskScheduler.Schedule(this->nowMs + waitMs, [this] {
+					this->resumeStepId = 0;
+					this->EvaluateActions();
+					});
+				return;
+			}
+		}
+		this->evalActionInd = -1;
+		context.nowMs = this->nowMs;
+		context.lastActionMs = this->lastActionMs;
+	}
+	this->evalStateInd = -1;
+}
+
+int64_t Worker::GetScanLateness(int objInd, uint32_t nowMs, uint64_t frameSeq) const
+{
+	if (this->objectScanMs[objInd] < 0) return INT64_MAX;
+	if (this->objectFrameSeq[objInd] == frameSeq) return -1; // Detecting the same frame again gives the same result.
+	return (int64_t)nowMs - this->objectScanMs[objInd] - this->config->GetObjectScanInterval(objInd);
+}
+
+bool Worker::HasDueObjects(uint32_t nowMs, uint64_t frameSeq) const
+{
+	const int objectCount = this->config->GetObjectCount();
+	if ((int)this->objectScanMs.size() != objectCount) return this->currentState->hasObjectToDetect;
+	for (int i = 0; i < objectCount; i++) {
+		if (this->currentState->objectsToDetect[i] && this->GetScanLateness(i, nowMs, frameSeq) >= 0) return true;
+	}
+	return false;
 }
 
-Worker::Worker(Config& config) : config(config), estimator(config.GetName(), config.GetCounterLimit()), frConfig(nullptr), grabImageFunc(nullptr), isExiting(false), isOnceStopped(false), currentState(config.GetInitialState()),
-lastDetection(), /*lastDetectionFirstValidRect(config.GetObjectCount(),0),*/ lastActionMs(0), nextScanMs(0), lastDetectionMs(0)
+bool Worker::SelectObjectsToScan(uint32_t nowMs, uint64_t frameSeq)
 {
+	const int objectCount = this->config->GetObjectCount();
+	if ((int)this->objectScanMs.size() != objectCount) {
+		this->objectScanMs.assign(objectCount, -1);
+		this->objectResultMs.assign(objectCount, -1);
+		this->objectFrameSeq.assign(objectCount, 0);
+		this->lastDetection.resize(objectCount);
+	}
+	this->objectsToScan.assign(objectCount, false);
+	// Due objects of the state: never scanned in it first, then by priority and by how late they are.
+	std::vector<std::pair<int, int64_t>> due; // (object, lateness)
+	for (int i = 0; i < objectCount; i++) {
+		if (!this->currentState->objectsToDetect[i]) continue;
+		if (this->objectScanMs[i] >= 0 && this->objectFrameSeq[i] == frameSeq) { // Still the newest frame, the result is current.
+			this->objectResultMs[i] = nowMs;
+			continue;
+		}
+		const int64_t lateMs = this->GetScanLateness(i, nowMs, frameSeq);
+		if (lateMs >= 0) { due.emplace_back(i, lateMs); }
+	}
+	const int limit = this->config->GetScanObjectLimit();
+	if (limit > 0 && due.size() > (size_t)limit) {
+		std::stable_sort(due.begin(), due.end(), [this](const std::pair<int, int64_t>& a, const std::pair<int, int64_t>& b) {
+			if ((a.second == INT64_MAX) != (b.second == INT64_MAX)) return a.second == INT64_MAX;
+			const int pa = this->config->GetObjectPriority(a.first), pb = this->config->GetObjectPriority(b.first);
+			return pa != pb ? pa > pb : a.second > b.second;
+			});
+		due.resize(limit);
+	}
+	for (const std::pair<int, int64_t>& d : due) { this->objectsToScan[d.first] = true; }
+	return !due.empty();
+}
+
+void Worker::CancelActionEvaluation()
+{
+	if (this->resumeStepId) { this->taskScheduler.Cancel(this->resumeStepId); }
+	this->resumeStepId = 0;
+	this->evalStateInd = -1;
+	this->evalActionInd = -1;
+}
+
+uint32_t Worker::LimitWaitToNextStep(uint32_t waitMs) const
+{
+	uint32_t dueMs;
+	if (!this->taskScheduler.GetNextDue(dueMs)) return waitMs;
+	const uint32_t nowMs = this->clock->NowMs();
+	return dueMs > nowMs ? std::min(waitMs, dueMs - nowMs) : 0;
+}
+
+Worker::Worker(Config& config) : config(&config), estimator(config.GetName(), config.GetCounterLimit()), frConfig(nullptr), grabImageFunc(nullptr), latencyTrace(nullptr), scheduler(nullptr), schedulerDevice(-1), lastFrameSeq(0), lastFrameState(nullptr), isExiting(false), isOnceStopped(false), isRunning(false), clock(&RealClock::Get()), currentState(config.GetInitialState()),
+lastDetection(), colorSkipsPerState(config.GetStates().size(), 0), /*lastDetectionFirstValidRect(config.GetObjectCount(),0),*/ lastActionMs(0), nextScanMs(0), lastDetectionMs(0), detectionVersion(0), committedDetectionVersion(0), evalStateInd(-1), evalActionInd(-1), evalPos(0), evalNextTask(0), resumeStepId(0), streamScale(1), preparedScale(1)
+{
+	this->UpdateObjectNames();
 }
 
 Worker::~Worker()
@@ -139,16 +283,99 @@ Worker::~Worker()
 void Worker::UpdateResolution(int width, int height)
 {
 	if (!this->frConfig.get() || this->frConfig->GetWidth() != width || this->frConfig->GetHeight() != height) {
-		this->frConfig = std::make_unique<FixedResolutionConfig>(config, width, height);
+		this->frConfig = std::make_unique<FixedResolutionConfig>(*this->config, width, height);
+	}
+}
+
+void Worker::Prepare(float expectedStreamScale)
+{
+	if (this->thread.joinable() || this->preparedDetector.valid()) { return; }
+	this->preparedScale = expectedStreamScale;
+	this->preparedDetector = std::async(std::launch::async, [this, expectedStreamScale] {
+		uint32_t startMs = SDL_GetTicks();
+		ObjDetect od = this->config->CreateDetector(expectedStreamScale);
+		std::cout << "Objects prepared in " << SDL_GetTicks() - startMs << " ms.\n";
+		return od;
+		});
+}
+
+void Worker::RequestConfig(std::shared_ptr<Config> config)
+{
+	if (!this->thread.joinable()) { // Not running, nothing to keep.
+		std::lock_guard<std::mutex> lock(this->pendingConfigMutex);
+		this->pendingConfig.reset();
+		this->ownedConfig = config;
+		this->config = config.get();
+		this->UpdateObjectNames();
+		this->currentState = this->config->GetInitialState();
+		this->colorSkipsPerState.assign(this->config->GetStates().size(), 0);
+		this->lastDetection.clear();
+		this->objectScanMs.clear();
+		this->objectResultMs.clear();
+		this->objectFrameSeq.clear();
+		this->CancelActionEvaluation();
+		if (this->frConfig) { this->frConfig = std::make_unique<FixedResolutionConfig>(*this->config, this->frConfig->GetWidth(), this->frConfig->GetHeight()); }
+		return;
 	}
+	std::lock_guard<std::mutex> lock(this->pendingConfigMutex);
+	this->pendingConfig = std::move(config); // A config requested before the previous one was applied replaces it.
+}
+
+void Worker::ApplyConfig(std::shared_ptr<Config> newConfig, ObjDetect& od)
+{
+	uint32_t startMs = SDL_GetTicks();
+	od = newConfig->CreateDetector(this->streamScale, &od);
+	if (!this->scheduler) cv::setNumThreads(newConfig->GetThreadCount());
+
+	// The state and the last detections are carried over by name.
+	const Config::State* newState = newConfig->GetInitialState();
+	for (const Config::State& state : newConfig->GetStates()) {
+		if (state.name == this->currentState->name) { newState = &state; break; }
+	}
+	std::vector<std::vector<RectProb>> newDetection(newConfig->GetObjectCount());
+	std::vector<int64_t> newScanMs(newConfig->GetObjectCount(), -1);
+	std::vector<int64_t> newResultMs(newConfig->GetObjectCount(), -1);
+	std::vector<uint64_t> newFrameSeq(newConfig->GetObjectCount(), 0);
+	for (size_t i = 0; i < this->lastDetection.size(); i++) {
+		const std::string& name = this->config->GetObjectName((int)i);
+		for (int j = 0; j < newConfig->GetObjectCount(); j++) {
+			if (newConfig->GetObjectName(j) == name) {
+				newDetection[j] = std::move(this->lastDetection[i]);
+				if (i < this->objectScanMs.size()) {
+					newScanMs[j] = this->objectScanMs[i];
+					newResultMs[j] = this->objectResultMs[i];
+					newFrameSeq[j] = this->objectFrameSeq[i];
+				}
+				break;
+			}
+		}
+	}
+
+	this->frConfig = std::make_unique<FixedResolutionConfig>(*newConfig, this->frConfig->GetWidth(), this->frConfig->GetHeight());
+	this->CancelActionEvaluation(); // Its action belongs to the old config, the touch releases are kept.
+	this->ownedConfig = newConfig;
+	this->config = newConfig.get();
+	this->UpdateObjectNames();
+	this->currentState = newState;
+	this->lastFrameState = nullptr; // Detect the current frame again with the new objects.
+	this->lastDetection = std::move(newDetection);
+	this->objectScanMs = std::move(newScanMs);
+	this->objectResultMs = std::move(newResultMs);
+	this->objectFrameSeq = std::move(newFrameSeq);
+	this->colorSkipsPerState.assign(this->config->GetStates().size(), 0);
+	this->estimator.SetCounterLimit(this->config->GetCounterLimit());
+	this->detectionVersion++;
+	this->CommitInfos();
+	std::cout << "Config applied in " << SDL_GetTicks() - startMs << " ms, state: " << this->currentState->name << '\n';
 }
 
 void Worker::Start()
 {
 	this->isExiting = false;
 	if (this->thread.joinable()) { return; } // Already started.
-	this->currentState = config.GetInitialState();
-	this->lastActionMs = SDL_GetTicks();
+	this->currentState = this->config->GetInitialState();
+	this->lastActionMs = this->clock->NowMs();
+	this->isRunning = true;
 	this->thread = std::thread(&Worker::Run, this);
 }
 
@@ -168,16 +395,37 @@ void Worker::Stop(bool waitForThread, bool once)
 
 void Worker::SetState(int stateInd)
 {
-	this->currentState = &config.GetStates()[stateInd];
+	this->currentState = &this->config->GetStates()[stateInd];
 }
 
 void Worker::SendTouchEvent(const cv::Point& p, bool isDown, const cv::Rect* r)
 {
-	this->workerInfos.GetLive().SetClickTime(SDL_GetTicks(), p.x, p.y, r);
-	if (touchFunc) { touchFunc(p.x, p.y, isDown); }
+	this->workerInfos.GetLive().SetClickTime(this->clock->NowMs(), p.x, p.y, r);
+	// The press is the input the latency is measured to.
+	if (touchFunc) { touchFunc(p.x, p.y, isDown, isDown && this->actionTiming.actionUs ? &this->actionTiming : nullptr); }
 }
+void Worker::UpdateObjectNames()
+{
+	auto names = std::make_shared<std::vector<std::string>>();
+	for (int i = 0; i < this->config->GetObjectCount(); i++) { names->push_back(this->config->GetObjectName(i)); }
+	this->objectNames = std::move(names);
+}
+
+void Worker::CommitInfos()
+{
+	// Only a new detection makes the live buffer dirty. It may also hold an older, already committed detection
+	// (the buffers are swapped, not copied), refreshing that one alone is not worth a commit and a render.
+	const bool isNewDetection = this->committedDetectionVersion != this->detectionVersion;
+	WorkerInfo& live = this->workerInfos.GetLive(isNewDetection);
+	if (live.detectionVersion != this->detectionVersion) {
+		live.SetDetections(this->lastDetection, this->detectionVersion, this->objectNames);
+	}
+	this->workerInfos.Commit();
+	this->committedDetectionVersion = this->detectionVersion;
+}
+
 uint32_t Worker::UpdateNow()
 {
-	this->nowMs = SDL_GetTicks();
+	this->nowMs = this->clock->NowMs();
 	return this->nowMs;
 }
@@ -4,30 +4,75 @@
 #include "Estimator.h"
 #include "ThreadSafeBuffer.h"
 #include "WorkerHelper.h"
+#include "FrameRing.h"
+#include "LatencyTrace.h"
+#include "DetectionScheduler.h"
+#include "TaskScheduler.h"
+#include "Clock.h"
 #include <opencv2/core.hpp>
 #include <memory>
 #include <vector>
 #include <functional>
+#include <future>
 #include <mutex>
 #include <thread>
 
 class Worker
 {
-	Config& config;
+	Config* config;
+	std::shared_ptr<Config> ownedConfig; // Reloaded config.
+	std::shared_ptr<const std::vector<std::string>> objectNames; // Of the current config, shared with the WorkerInfo snapshots.
+	std::shared_ptr<Config> pendingConfig; // Requested by RequestConfig, applied between two scans.
+	std::mutex pendingConfigMutex;
 	std::unique_ptr<FixedResolutionConfig> frConfig;
 	Estimator estimator;
 	ThreadSafeBuffer<WorkerInfo> workerInfos;
-	std::function<uint8_t*()> grabImageFunc;
-	std::function<void(int, int, bool)> touchFunc;
+	std::function<FrameRing::FrameLease(uint64_t afterSeq, uint32_t timeoutMs)> grabImageFunc;
+	LatencyHistogram frameLatency; // From frame conversion to the end of its detection.
+	LatencyTrace* latencyTrace; // Shared with the controller, owned by the Environment.
+	DetectionScheduler* scheduler; // Shared by the devices in multi-device mode, nullptr = detect on the own thread.
+	int schedulerDevice;
+	FrameTiming detectionTiming; // Frame of the last detection.
+	FrameTiming actionTiming; // Last fired action, passed with its touch events.
+	uint64_t lastFrameSeq; // Sequence number of the last grabbed frame.
+	const Config::State* lastFrameState; // State in which lastFrameSeq was grabbed.
+	std::function<void(int, int, bool, const FrameTiming*)> touchFunc;
 	bool isExiting, isOnceStopped;
+	std::atomic<bool> isRunning; // Until the thread method returns, also if the thread was detached.
+	Clock* clock; // Time of the detections, actions and tasks.
 	std::thread thread;
 	const Config::State* currentState;
-	std::vector<std::vector<RectProb>> lastDetection;
+	std::vector<std::vector<RectProb>> lastDetection; // Last result of every object, kept between the scans of an object.
+	std::vector<int64_t> objectScanMs; // Time of each object's last scan, -1 = not scanned in the current state.
+	std::vector<int64_t> objectResultMs; // Last time each object's result was known to describe the screen (see max_age), -1 = none.
+	std::vector<uint64_t> objectFrameSeq; // Frame each object's last result was detected on, 0 = none.
+	std::vector<bool> objectsToScan; // Objects of the current scan.
+	std::vector<size_t> colorSkipsPerState; // Objects skipped by the colour prefilter.
 	//std::vector<int> lastDetectionFirstValidRect;
 	uint32_t lastActionMs, nextScanMs, lastDetectionMs, nowMs;
+	uint64_t detectionVersion; // Incremented when lastDetection changes.
+	uint64_t committedDetectionVersion; // Last detectionVersion committed to workerInfos.
+	TaskScheduler taskScheduler; // Touch releases and continuations of the actions waiting between two tasks.
+	int evalStateInd, evalActionInd; // Action evaluation in progress: its state (-1 = none) and its fired action with tasks left (-1 = none).
+	uint32_t evalPos; // Next position in the state's action list.
+	size_t evalNextTask;
+	uint64_t resumeStepId; // Scheduled continuation of the waiting action, 0 = not waiting.
 	bool takeScreenshot;
+	float streamScale; // Frame resolution relative to the device resolution.
+	std::future<ObjDetect> preparedDetector; // Created by Prepare, used if its scale matches streamScale.
+	float preparedScale;
 
 	void Run(); // Thread method.
+	void ApplyConfig(std::shared_ptr<Config> newConfig, ObjDetect& od);
+	void UpdateObjectNames();
+	void EvaluateActions(); // Fires the satisfied actions, returns early when a task has to wait (continued by the task scheduler).
+	void CancelActionEvaluation();
+	int64_t GetScanLateness(int objInd, uint32_t nowMs, uint64_t frameSeq) const; // Negative if the object is not due on the frame.
+	bool HasDueObjects(uint32_t nowMs, uint64_t frameSeq) const;
+	// Fills objectsToScan with the due objects of the state, false if none. frameSeq must be the newest frame:
+	// the results already detected on it still describe the screen, their objectResultMs is refreshed instead.
+	bool SelectObjectsToScan(uint32_t nowMs, uint64_t frameSeq);
+	uint32_t LimitWaitToNextStep(uint32_t waitMs) const; // Shortens a wait so the next scheduled step is not late.
 public:
 	Worker(Config& config);
 
@@ -35,17 +80,26 @@ public:
 
 	void UpdateResolution(int width, int height);
 
+	void Prepare(float expectedStreamScale); // Creates the detector (object descriptors) in the background, before the first frame is known.
 	void Start(); // Starts a background thread executing the Run method.
+	// Switches to the config between two scans, the features of the unchanged objects and the estimator are kept.
+	void RequestConfig(std::shared_ptr<Config> config);
 	void Stop(bool waitForThread, bool once=false);
 
-	void SetGrabImageFunct(const std::function<uint8_t*()>& f) { this->grabImageFunc = f; }
-	void SetTouchFunct(const std::function<void(int, int, bool)>& f) { this->touchFunc = f; }
+	void SetGrabImageFunct(const std::function<FrameRing::FrameLease(uint64_t, uint32_t)>& f) { this->grabImageFunc = f; }
+	const LatencyHistogram& GetFrameLatency() const { return this->frameLatency; }
+	void SetStreamScale(float scale) { this->streamScale = scale; } // Call before Start.
+	void SetTouchFunct(const std::function<void(int, int, bool, const FrameTiming*)>& f) { this->touchFunc = f; }
+	void SetLatencyTrace(LatencyTrace* trace) { this->latencyTrace = trace; }
+	void SetScheduler(DetectionScheduler* scheduler, int device) { this->scheduler = scheduler; this->schedulerDevice = device; } // Call before Start.
+	void SetClock(Clock* clock) { this->clock = clock; } // Call before Start.
+	bool IsRunning() const { return this->isRunning; }
 
 	const std::vector<std::vector<RectProb>>& GetLastDetection() const { return this->lastDetection; }
 	std::vector<std::vector<RectProb>>& GetLastDetection() { return this->lastDetection; }
 
 	const FixedResolutionConfig& GetFixResConfig() const { return *this->frConfig; }
-	const Config& GetConfig() const { return this->config; }
+	const Config& GetConfig() const { return *this->config; }
 	Estimator& GetEstimator() { return this->estimator; }
 	const Config::State* GetState() { return this->currentState; }
 	void SetState(int stateInd);
@@ -54,7 +108,9 @@ public:
 	uint32_t GetLastAction() const { return this->lastActionMs; }
 	uint32_t GetNow() const { return this->nowMs; }
 	uint32_t UpdateNow();
+	TaskScheduler& GetTaskScheduler() { return this->taskScheduler; }
 	ThreadSafeBuffer<WorkerInfo>& GetInfos() { return this->workerInfos; }
+	void CommitInfos(); // Commits the live WorkerInfo with the last detection.
 	void TakeScreenshot() { this->takeScreenshot = true; }
 	
 };
@@ -1,21 +1,31 @@
 #pragma once
+#include <span>
+#include <memory>
+#include <string>
 
 class FixedResolutionConfig {
 	int width, height;
 	std::vector<cv::Mat> screenMasksPerState;
+	std::vector<std::vector<cv::Rect>> objectScanRectsPerState; // Union of the object requirements' scan rects (empty if the object is not scanned).
+	std::vector<cv::Rect> requirementScanRects; // Scan rect of every decision table requirement.
 public:
 	FixedResolutionConfig(const Config& config, int width, int height);
 	int GetWidth() const { return width; };
 	int GetHeight() const { return height; };
 	cv::Size GetSize() const { return cv::Size(width, height); }
+	const std::vector<cv::Rect>& GetObjectScanRects(int stateInd) const { return objectScanRectsPerState[stateInd]; }
+	const std::vector<cv::Rect>& GetRequirementScanRects() const { return requirementScanRects; }
 };
 
 class WorkerInfo {
+	std::vector<RectProb> rects; // Detections of every object, one after the other (the capacity is reused).
+	std::vector<uint32_t> objectOffsets; // Start of each object's detections in rects, followed by the end.
+	std::shared_ptr<const std::vector<std::string>> objectNames; // Of the config the detections belong to, the renderer never reads the (reloadable) config.
 public:
-	std::vector<std::vector<RectProb>> detections;
+	uint64_t detectionVersion = 0; // Detection the rects belong to.
 	cv::Rect clickRect;
-	uint32_t lastClickTime;
-	int lastClickX, lastClickY;
+	uint32_t lastClickTime = 0;
+	int lastClickX = 0, lastClickY = 0;
 	void SetClickTime(uint32_t time, int x, int y, const cv::Rect* r)
 	{
 		lastClickTime = time;
@@ -23,14 +33,31 @@ public:
 		lastClickY = y;
 		if (r) { clickRect = *r; }
 	}
-	void SetDetections(const std::vector<std::vector<RectProb>>& d)
+	void SetDetections(const std::vector<std::vector<RectProb>>& d, uint64_t version, const std::shared_ptr<const std::vector<std::string>>& names)
 	{
-		this->detections.resize(d.size());
-		for (int i = 0; i < d.size(); i++) {
-			this->detections[i].resize(d[i].size());
-			for (int j = 0; j < d[i].size(); j++) {
-				this->detections[i][j] = d[i][j];
-			}
+		this->objectNames = names;
+		this->rects.clear();
+		this->objectOffsets.clear();
+		for (const std::vector<RectProb>& objRects : d) {
+			this->objectOffsets.push_back((uint32_t)this->rects.size());
+			this->rects.insert(this->rects.end(), objRects.begin(), objRects.end());
 		}
+		this->objectOffsets.push_back((uint32_t)this->rects.size());
+		this->detectionVersion = version;
+	}
+	size_t GetObjectCount() const { return this->objectOffsets.empty() ? 0 : this->objectOffsets.size() - 1; }
+	const std::string& GetObjectName(size_t objInd) const
+	{
+		static const std::string unknown;
+		return (this->objectNames && objInd < this->objectNames->size()) ? (*this->objectNames)[objInd] : unknown;
+	}
+	std::span<const RectProb> GetDetections(size_t objInd) const { return std::span<const RectProb>(this->rects).subspan(this->objectOffsets[objInd], this->objectOffsets[objInd + 1] - this->objectOffsets[objInd]); }
+	// Called on the new live buffer after a commit: the click is carried over, the detections are set by the Worker when they changed (see Worker::CommitInfos).
+	void CarryOver(const WorkerInfo& committed)
+	{
+		this->clickRect = committed.clickRect;
+		this->lastClickTime = committed.lastClickTime;
+		this->lastClickX = committed.lastClickX;
+		this->lastClickY = committed.lastClickY;
 	}
 };
@@ -39,6 +39,15 @@ bool ConsoleCommands::Execute(const std::string& function, const std::string& pa
         this->env->EnableWorker(false);
         return true;
     }
+    else if (function == "latency") {
+        if (params == "reset") {
+            this->env->GetLatency().Reset();
+        }
+        else {
+            printf("%s", this->env->GetLatency().ToString().c_str());
+        }
+        return true;
+    }
     else if (function == "limit") {
         uint32_t limit = std::strtoul(params.c_str(), nullptr, 10);
         this->env->UpdateCounterLimit(limit);
@@ -8,7 +8,7 @@
 /**
  * Constructor
  */
-GLConsole::GLConsole(SDL_Window& window) :
+GLConsole::GLConsole(SDL_Window* window) :
     // Init our member cvars  (can't init the names in the class decleration)
     m_fConsoleBlinkRate(CVarUtils::CreateCVar<float>("console.BlinkRate", 4.0)), // cursor blinks per sec
     m_fConsoleAnimTime(CVarUtils::CreateCVar<float>("console.AnimTime", 0.1)),     // time the console animates
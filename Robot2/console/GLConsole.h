@@ -145,7 +145,7 @@ class GLConsole
     friend void GLConsoleCheckInit(GLConsole* pConsole);
 
 public:
-    GLConsole(SDL_Window& window);
+    GLConsole(SDL_Window* window); // window is null in headless mode.
     ~GLConsole();
 
     // Use this before using commands.
@@ -325,7 +325,7 @@ protected:
     std::deque<ConsoleLine> m_consoleText; // all the console text
     std::deque<ConsoleLine> m_ScriptText; // all the console text
 
-    SDL_Window& window;
+    SDL_Window* window;
 };
 
 
@@ -414,7 +414,7 @@ inline void GLConsole::Init()
     // if the width and height ptrs aren't supplied then just extract the info
     // from GL
     //glGetIntegerv(GL_VIEWPORT, &m_Viewport.x);
-    SDL_GetWindowSize(&this->window, &m_Viewport.width, &m_Viewport.height);
+    SDL_GetWindowSize(this->window, &m_Viewport.width, &m_Viewport.height);
 
     // add basic functions to the console
     CVarUtils::CreateCVar("console.version", ConsoleVersion, "The current version of GLConsole");
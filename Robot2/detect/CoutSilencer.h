@@ -0,0 +1,13 @@
+#pragma once
+
+#include <iostream>
+
+// Silences std::cout while alive, also restored when the silenced code throws.
+class CoutSilencer {
+	std::streambuf* coutBuf;
+public:
+	CoutSilencer() : coutBuf(std::cout.rdbuf(nullptr)) {}
+	~CoutSilencer() { std::cout.rdbuf(this->coutBuf); }
+	CoutSilencer(const CoutSilencer&) = delete;
+	CoutSilencer& operator=(const CoutSilencer&) = delete;
+};
@@ -0,0 +1,134 @@
+#include "DescriptorCache.h"
+#include "../scrcpy/util/sha256.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+	const char magic[4] = { 'R', '2', 'D', 'C' };
+	const uint32_t version = 1;
+
+	struct KeyPointRecord { float x, y, size, angle, response; int32_t octave, classId; };
+
+	template<typename T> void Write(std::ostream& out, const T& value) { out.write((const char*)&value, sizeof(T)); }
+	template<typename T> bool Read(std::istream& in, T& value) { return (bool)in.read((char*)&value, sizeof(T)); }
+
+	void WriteFeatures(std::ostream& out, const ObjDetect::ImageFeatures& features)
+	{
+		Write(out, (int32_t)features.size.width); Write(out, (int32_t)features.size.height);
+		Write(out, features.scale);
+		Write(out, (uint32_t)features.keypoints.size());
+		for (const cv::KeyPoint& kp : features.keypoints) {
+			Write(out, KeyPointRecord{ kp.pt.x, kp.pt.y, kp.size, kp.angle, kp.response, kp.octave, kp.class_id });
+		}
+		cv::Mat desc = features.descriptors.isContinuous() ? features.descriptors : features.descriptors.clone();
+		Write(out, (int32_t)desc.rows); Write(out, (int32_t)desc.cols); Write(out, (int32_t)desc.type());
+		out.write((const char*)desc.data, desc.total() * desc.elemSize());
+		Write(out, features.color.bins); Write(out, features.color.area);
+		Write(out, (int32_t)features.color.size.width); Write(out, (int32_t)features.color.size.height);
+		Write(out, (uint8_t)(features.refine ? 1 : 0));
+		if (features.refine) { WriteFeatures(out, *features.refine); }
+	}
+
+	// Bytes left until fileEnd, the counts read from the file are checked against it before allocating.
+	uint64_t Remaining(std::istream& in, std::streamoff fileEnd)
+	{
+		const std::streamoff pos = in.tellg();
+		return (pos < 0 || pos > fileEnd) ? 0 : (uint64_t)(fileEnd - pos);
+	}
+
+	bool ReadFeatures(std::istream& in, ObjDetect::ImageFeatures& features, std::streamoff fileEnd)
+	{
+		int32_t width, height, rows, cols, type;
+		uint32_t keypointCount;
+		if (!Read(in, width) || !Read(in, height) || !Read(in, features.scale) || !Read(in, keypointCount)) return false;
+		if ((uint64_t)keypointCount * sizeof(KeyPointRecord) > Remaining(in, fileEnd)) return false;
+		features.size = cv::Size(width, height);
+		std::vector<KeyPointRecord> records(keypointCount);
+		if (!in.read((char*)records.data(), records.size() * sizeof(KeyPointRecord))) return false;
+		features.keypoints.clear();
+		features.keypoints.reserve(keypointCount);
+		for (const KeyPointRecord& r : records) {
+			features.keypoints.emplace_back(cv::Point2f(r.x, r.y), r.size, r.angle, r.response, r.octave, r.classId);
+		}
+		if (!Read(in, rows) || !Read(in, cols) || !Read(in, type) || rows < 0 || cols < 0) return false;
+		if (type != CV_8UC1 && type != CV_32FC1) return false; // Binary or float descriptors.
+		if ((uint64_t)rows * (uint64_t)cols * CV_ELEM_SIZE(type) > Remaining(in, fileEnd)) return false;
+		features.descriptors.create(rows, cols, type);
+		if (!in.read((char*)features.descriptors.data, features.descriptors.total() * features.descriptors.elemSize())) return false;
+		int32_t colorWidth, colorHeight;
+		uint8_t hasRefine;
+		if (!Read(in, features.color.bins) || !Read(in, features.color.area) || !Read(in, colorWidth) || !Read(in, colorHeight) || !Read(in, hasRefine)) return false;
+		features.color.size = cv::Size(colorWidth, colorHeight);
+		features.refine.reset();
+		if (hasRefine) {
+			features.refine = std::make_shared<ObjDetect::ImageFeatures>();
+			if (!ReadFeatures(in, *features.refine, fileEnd)) return false;
+		}
+		return true;
+	}
+}
+
+DescriptorCache::DescriptorCache(const std::filesystem::path& dir) : dir(dir)
+{
+	if (this->dir.empty()) return;
+	std::error_code error;
+	std::filesystem::create_directories(this->dir, error);
+	if (error) {
+		std::cerr << "Descriptor cache disabled, cannot create " << this->dir << ": " << error.message() << '\n';
+		this->dir.clear();
+	}
+}
+
+std::string DescriptorCache::GetKey(const std::vector<uint8_t>& imageFile, const std::string& settings)
+{
+	std::vector<uint8_t> keyData(imageFile);
+	keyData.insert(keyData.end(), settings.begin(), settings.end());
+	char hex[SHA256_HEX_LENGTH + 1];
+	sha256_hex(keyData.data(), keyData.size(), hex);
+	return std::string(hex, 32); // 128 bits are plenty for file names.
+}
+
+bool DescriptorCache::Load(const std::string& key, ObjDetect::ImageFeatures& features) const
+{
+	if (!this->IsEnabled()) return false;
+	try { // A damaged file is recomputed and overwritten.
+		std::ifstream in(this->GetPath(key), std::ios::binary | std::ios::ate);
+		if (!in) return false;
+		const std::streamoff fileEnd = in.tellg();
+		in.seekg(0);
+		char fileMagic[4];
+		uint32_t fileVersion;
+		if (!in.read(fileMagic, sizeof(fileMagic)) || memcmp(fileMagic, magic, sizeof(magic)) || !Read(in, fileVersion) || fileVersion != version) return false;
+		return ReadFeatures(in, features, fileEnd);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Descriptor cache file " << this->GetPath(key) << " is unreadable: " << e.what() << '\n';
+		return false;
+	}
+}
+
+void DescriptorCache::Store(const std::string& key, const ObjDetect::ImageFeatures& features) const
+{
+	if (!this->IsEnabled()) return;
+	// Written under a unique name and renamed, so other threads and processes never read a partial file.
+	std::ostringstream tmpName;
+	tmpName << key << '.' << std::this_thread::get_id() << ".tmp";
+	std::filesystem::path tmpPath = this->dir / tmpName.str();
+	{
+		std::ofstream out(tmpPath, std::ios::binary);
+		out.write(magic, sizeof(magic));
+		Write(out, version);
+		WriteFeatures(out, features);
+		if (!out) {
+			out.close();
+			std::filesystem::remove(tmpPath);
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tmpPath, this->GetPath(key), error);
+	if (error) { std::filesystem::remove(tmpPath, error); }
+}
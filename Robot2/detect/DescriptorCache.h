@@ -0,0 +1,23 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "ObjDetect.h"
+
+// Keypoints and descriptors of the config objects saved on disk, one file per object.
+// The file name is a hash of the image content and of every setting the features depend on, so a changed image,
+// detector, parameter or channel simply gets a new file (old files are never read again and can be deleted).
+class DescriptorCache
+{
+	std::filesystem::path dir;
+
+	std::filesystem::path GetPath(const std::string& key) const { return this->dir / (key + ".feat"); }
+public:
+	DescriptorCache(const std::filesystem::path& dir);
+	bool IsEnabled() const { return !this->dir.empty(); }
+
+	static std::string GetKey(const std::vector<uint8_t>& imageFile, const std::string& settings);
+	bool Load(const std::string& key, ObjDetect::ImageFeatures& features) const; // False if missing or unreadable.
+	void Store(const std::string& key, const ObjDetect::ImageFeatures& features) const;
+};
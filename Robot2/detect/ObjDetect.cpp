@@ -4,6 +4,10 @@
 #include <opencv2/calib3d.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp> // imwrite
+#include <map>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 
 cv::Mat ObjDetect::PreprocessImage(const cv::Mat& image, const std::string& channel)
 {
@@ -46,12 +50,11 @@ void ObjDetect::PreprocessImage(const cv::Mat& inImage, cv::Mat& outImage, const
     }
 }
 
-ObjDetect::DetectorHolder ObjDetect::GetDetector(enum Detector id)
+ObjDetect::DetectorHolder ObjDetect::GetDetector(enum Detector id, const DetectorParams& params)
 {
     BenchmarkT<"GetDetector"> _b;
-    if (ObjDetect::detectors.size() > (int)id) {
-        DetectorHolder dh = ObjDetect::detectors[(int)id];
-        if (!dh.detectAlgo.empty()) return dh;
+    for (const CachedDetector& cached : ObjDetect::detectors) {
+        if (cached.id == id && cached.params == params) return cached.holder;
     }
     DetectorHolder result;
     switch (id)
@@ -63,35 +66,35 @@ ObjDetect::DetectorHolder ObjDetect::GetDetector(enum Detector id)
         result.detectAlgo = cv::AKAZE::create(cv::AKAZE::DESCRIPTOR_KAZE_UPRIGHT);
         break;
     case Detector::ORB_BEBLID:
-        result.computeAlgo = cv::xfeatures2d::BEBLID::create(1.0f, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
+        result.computeAlgo = cv::xfeatures2d::BEBLID::create(params.orbBeblidScale, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
         // not breaking.
     case Detector::ORB:
     {
-        const int edgeThreshold = 8;
-        const int patchSize = 24; //std::min(img2.cols, img2.rows) - edgeThreshold * 2 - 5;
+        const int edgeThreshold = params.orbEdgeThreshold;
+        const int patchSize = params.orbPatchSize; //std::min(img2.cols, img2.rows) - edgeThreshold * 2 - 5;
         //result.detectAlgo = cv::ORB::create(100000, 1.2f, 8, edgeThreshold, 0, 2, cv::ORB::ScoreType::HARRIS_SCORE, patchSize, 20);
-        result.detectAlgo = cv::ORB::create(100000, 1.1f, 16, edgeThreshold, 0, 2, cv::ORB::ScoreType::HARRIS_SCORE, patchSize, 20);
+        result.detectAlgo = cv::ORB::create(params.orbFeatures, params.orbScale, params.orbLevels, edgeThreshold, 0, 2, cv::ORB::ScoreType::HARRIS_SCORE, patchSize, params.orbFastThreshold);
     }
         break;
     case Detector::BRISK_BEBLID:
-        result.computeAlgo = cv::xfeatures2d::BEBLID::create(5.f, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
+        result.computeAlgo = cv::xfeatures2d::BEBLID::create(params.briskBeblidScale, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
         // not breaking.
     case Detector::BRISK:
-        result.detectAlgo = cv::BRISK::create(60, 6, 1.0f);
+        result.detectAlgo = cv::BRISK::create(params.briskThreshold, params.briskOctaves, params.briskPatternScale);
         break;
     case Detector::SURF_BEBLID:
-        result.computeAlgo = cv::xfeatures2d::BEBLID::create(6.25f, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
+        result.computeAlgo = cv::xfeatures2d::BEBLID::create(params.surfBeblidScale, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
         // not breaking.
     case Detector::SURF:
         result.detectAlgo = cv::xfeatures2d::SURF::create(
-            100.0,		// threshold (default = 100.0)
-            4,			// number of octaves (default=4)
-            3,			// number of octave layers within each octave (default=3)
+            params.surfHessian,	// threshold (default = 100.0)
+            params.surfOctaves,	// number of octaves (default=4)
+            params.surfLayers,	// number of octave layers within each octave (default=3)
             false,		// true=use 128 element descriptors, false=use 64 element (def=false)
             false);		// true=don't compute orientation, false=compute orientation (def=false)
         break;
     case Detector::SIFT_BEBLID:
-        result.computeAlgo = cv::xfeatures2d::BEBLID::create(6.75f, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
+        result.computeAlgo = cv::xfeatures2d::BEBLID::create(params.siftBeblidScale, cv::xfeatures2d::BEBLID::BeblidSize::SIZE_512_BITS);
         // not breaking.
     case Detector::SIFT:
         result.detectAlgo = cv::SIFT::create();
@@ -100,12 +103,24 @@ ObjDetect::DetectorHolder ObjDetect::GetDetector(enum Detector id)
         printf("ObjDetect::GetDetector called with invalid Detector!\n");
         return result;
     }
-    ObjDetect::detectors.resize((int)id + 1);
-    ObjDetect::detectors[(int)id] = result;
+    if (ObjDetect::detectors.size() >= 16) { ObjDetect::detectors.erase(ObjDetect::detectors.begin()); } // The tuner tries many params.
+    ObjDetect::detectors.push_back(CachedDetector{ id, params, result });
     return result;
 }
 
-std::tuple<std::vector<cv::KeyPoint>, cv::Mat> ObjDetect::FindKeypoints(const cv::Mat& image, enum Detector detector)
+void ObjDetect::SetDetectorParams(const DetectorParams& params)
+{
+    std::lock_guard<std::mutex> lock(ObjDetect::detectorParamsMutex);
+    ObjDetect::detectorParams = params;
+}
+
+ObjDetect::DetectorParams ObjDetect::GetDetectorParams()
+{
+    std::lock_guard<std::mutex> lock(ObjDetect::detectorParamsMutex);
+    return ObjDetect::detectorParams;
+}
+
+std::tuple<std::vector<cv::KeyPoint>, cv::Mat> ObjDetect::FindKeypoints(const cv::Mat& image, enum Detector detector, const DetectorParams* params)
 {
     /*cv::Mat bigMask = cv::Mat();
     if (image.rows > 1000 && image.cols > 1000) {
@@ -114,7 +129,7 @@ std::tuple<std::vector<cv::KeyPoint>, cv::Mat> ObjDetect::FindKeypoints(const cv
     }*/
 
     BenchmarkT<"FindKeypoints"> _b;
-    DetectorHolder holder = ObjDetect::GetDetector(detector);
+    DetectorHolder holder = ObjDetect::GetDetector(detector, params ? *params : ObjDetect::GetDetectorParams());
     std::vector<cv::KeyPoint> keyImg;
     holder.detectAlgo->detect(image, keyImg, cv::Mat());//bigMask);//);
 
@@ -404,7 +419,7 @@ void drawCorners(cv::Mat& result, const cv::Mat& objImg, const cv::Mat& h, const
     cv::circle(result, scene_corners[0], 5, color, -1);
 }
 
-std::vector<RectProb> ObjDetect::FindObject(const cv::Mat& srcImg, const cv::Mat& objImg, enum Detector detector, cv::DescriptorMatcher::MatcherType matcher, cv::Mat* debugImage)
+std::vector<RectProb> ObjDetect::FindObject(const cv::Mat& srcImg, const cv::Mat& objImg, enum Detector detector, cv::DescriptorMatcher::MatcherType matcher, cv::Mat* debugImage, FindObjectStats* stats)
 {
     BenchmarkT<"FindObject"> _b;
     const cv::Mat& srci = (srcImg.channels() > 1) ? PreprocessImage(srcImg) : srcImg;
@@ -421,6 +436,11 @@ std::vector<RectProb> ObjDetect::FindObject(const cv::Mat& srcImg, const cv::Mat
 
     std::vector<cv::DMatch> matches = MatchDescriptors(srcDesc, objDesc, matcher);
     std::tuple<std::vector<cv::Point2f>, std::vector<cv::Point2f>> points = GetMatchedPoints(matches, srcKey, objKey);
+    if (stats) {
+        stats->srcKeypoints = srcKey.size();
+        stats->objKeypoints = objKey.size();
+        stats->matches = matches.size();
+    }
     if (matches.empty()) { return std::vector<RectProb>{}; }
 
     std::unique_ptr<std::list<cv::Mat>> hList = debugImage ? std::make_unique<std::list<cv::Mat>>() : nullptr;
@@ -443,22 +463,54 @@ std::vector<RectProb> ObjDetect::FindObject(const cv::Mat& srcImg, const cv::Mat
     return rects;
 }
 
-ObjDetect::ImageFeatures::ImageFeatures(const cv::Mat& img, enum Detector detector)
+ObjDetect::ImageFeatures::ImageFeatures(const cv::Mat& img, enum Detector detector, const DetectorParams* params)
     : size(img.cols, img.rows)
 {
-    std::tuple<std::vector<cv::KeyPoint>, cv::Mat> findKpRes = ObjDetect::FindKeypoints(img, detector);
+    std::tuple<std::vector<cv::KeyPoint>, cv::Mat> findKpRes = ObjDetect::FindKeypoints(img, detector, params);
     this->keypoints = std::get<0>(findKpRes);
     this->descriptors = std::get<1>(findKpRes);
 }
 
-ObjDetect::ObjDetect(enum Detector detector, cv::DescriptorMatcher::MatcherType matcher, const std::string& channel)
-    :detector(detector), matcher(matcher), channel(channel)
+ObjDetect::ObjDetect(enum Detector detector, cv::DescriptorMatcher::MatcherType matcher, const std::string& channel, const DetectorParams* params)
+    :detector(detector), matcher(matcher), channel(channel), params(params ? *params : ObjDetect::GetDetectorParams())
+{
+}
+
+
+void ObjDetect::SetScale(float scale, bool refine)
+{
+    this->scale = std::clamp(scale, 0.05f, 1.f);
+    this->refine = refine;
+}
+
+int ObjDetect::AddObject(const cv::Mat& objImg, float scale)
 {
+    return this->AddObject(this->ComputeObject(objImg, scale));
 }
 
+int ObjDetect::AddObject(ImageFeatures&& features)
+{
+    this->objects.push_back(std::move(features));
+    return this->objects.size() - 1;
+}
 
-int ObjDetect::AddObject(const cv::Mat& objImg)
+std::string ObjDetect::GetFeatureSettings(float scale) const
 {
+    const float objScale = (scale > 0) ? std::clamp(scale, 0.05f, 1.f) : this->scale; // Same range as SetScale.
+    const DetectorParams& p = this->params;
+    std::ostringstream s;
+    s << std::setprecision(9) << "detector=" << (int)this->detector << " channel=" << this->channel
+        << " scale=" << objScale << " refine=" << (objScale < 1 && this->refine)
+        << " orb=" << p.orbFeatures << ',' << p.orbScale << ',' << p.orbLevels << ',' << p.orbEdgeThreshold << ',' << p.orbPatchSize << ',' << p.orbFastThreshold
+        << " brisk=" << p.briskThreshold << ',' << p.briskOctaves << ',' << p.briskPatternScale
+        << " surf=" << p.surfHessian << ',' << p.surfOctaves << ',' << p.surfLayers
+        << " beblid=" << p.orbBeblidScale << ',' << p.briskBeblidScale << ',' << p.surfBeblidScale << ',' << p.siftBeblidScale;
+    return s.str();
+}
+
+ObjDetect::ImageFeatures ObjDetect::ComputeObject(const cv::Mat& objImg, float scale) const
+{
+    if (objImg.empty()) return ImageFeatures(); // Missing image, the object is never found.
     cv::Mat objImg1ch;
     const cv::Mat* objImgPtr;
     if (objImg.channels() == 1) { objImgPtr = &objImg; }
@@ -466,9 +518,22 @@ int ObjDetect::AddObject(const cv::Mat& objImg)
         ObjDetect::PreprocessImage(objImg, objImg1ch, this->channel);
         objImgPtr = &objImg1ch;
     } 
+    ColorHistogram color = (objImg.channels() >= 3) ? ColorHistogram(objImg) : ColorHistogram();
 
-    this->objects.emplace_back(*objImgPtr, this->detector);
-    return this->objects.size() - 1;
+    float objScale = (scale > 0) ? std::clamp(scale, 0.05f, 1.f) : this->scale;
+    if (objScale == 1) {
+        ImageFeatures features(*objImgPtr, this->detector, &this->params);
+        features.color = color;
+        return features;
+    }
+    // The object is matched on a downsampled base image, so its features are calculated at the same scale.
+    cv::Mat scaledObj;
+    cv::resize(*objImgPtr, scaledObj, cv::Size(), objScale, objScale, cv::INTER_AREA);
+    ImageFeatures features(scaledObj, this->detector, &this->params);
+    features.scale = objScale;
+    features.color = color;
+    if (this->refine) { features.refine = std::make_shared<ImageFeatures>(*objImgPtr, this->detector, &this->params); }
+    return features;
 }
 
 void ObjDetect::UpdateBaseImage(cv::Mat&& srcImg)
@@ -478,15 +543,19 @@ void ObjDetect::UpdateBaseImage(cv::Mat&& srcImg)
     //printf("Updated Base Image: %d x %d \n", this->srcImg.cols, this->srcImg.rows);
 }
 
-std::vector<std::vector<RectProb>> ObjDetect::FindObjects(const std::vector<bool>* objectMask)
+std::vector<std::vector<RectProb>> ObjDetect::FindObjects(const std::vector<bool>* objectMask, const std::vector<cv::Rect>* scanRects)
 {
+    this->skippedObjects = 0;
+    bool useColorPrefilter = this->colorPrefilter > 0 && this->srcImg.channels() >= 3;
+    if (useColorPrefilter) {
+        this->UpdateColorIntegral(this->srcImg); // Must be done before the colours are discarded.
+    }
     if (this->srcImg.channels() > 1) {
         ObjDetect::PreprocessImageInplace(this->srcImg, this->channel);
     }
 
-    std::tuple<std::vector<cv::KeyPoint>, cv::Mat> srcKeyT = FindKeypoints(this->srcImg, this->detector);
-    const std::vector<cv::KeyPoint>& srcKey = std::get<0>(srcKeyT);
-    const cv::Mat& srcDesc = std::get<1>(srcKeyT);
+    // Base image keypoints for each detection scale, calculated on first use.
+    std::map<float, std::tuple<std::vector<cv::KeyPoint>, cv::Mat, cv::Size>> srcFeatures;
 
     int objInd = 0;
     std::vector<std::vector<RectProb>> result(this->objects.size());
@@ -494,18 +563,142 @@ std::vector<std::vector<RectProb>> ObjDetect::FindObjects(const std::vector<bool
     for (const ImageFeatures& object : this->objects)
     {
         if (objectMask && !(*objectMask)[objInd]) { objInd++; continue; } // Ignore masked object.
+        if (useColorPrefilter) {
+            cv::Rect region = (scanRects && !(*scanRects)[objInd].empty()) ? (*scanRects)[objInd] : cv::Rect(0, 0, this->srcImg.cols, this->srcImg.rows);
+            if (!this->ColorMayBePresent(object.color, region)) { this->skippedObjects++; objInd++; continue; }
+        }
+
+        auto srcIt = srcFeatures.find(object.scale);
+        if (srcIt == srcFeatures.end()) {
+            cv::Mat scaledSrc = this->srcImg;
+            if (object.scale != 1) {
+                BenchmarkT<"DownsampleBaseImage"> _b;
+                cv::resize(this->srcImg, scaledSrc, cv::Size(), object.scale, object.scale, cv::INTER_AREA);
+            }
+            std::tuple<std::vector<cv::KeyPoint>, cv::Mat> srcKeyT = FindKeypoints(scaledSrc, this->detector, &this->params);
+            srcIt = srcFeatures.try_emplace(object.scale, std::move(std::get<0>(srcKeyT)), std::move(std::get<1>(srcKeyT)), scaledSrc.size()).first;
+        }
+        const std::vector<cv::KeyPoint>& srcKey = std::get<0>(srcIt->second);
+        const cv::Mat& srcDesc = std::get<1>(srcIt->second);
 
         std::vector<cv::DMatch> matches = MatchDescriptors(srcDesc, object.descriptors, this->matcher);
         std::tuple<std::vector<cv::Point2f>, std::vector<cv::Point2f>> points = GetMatchedPoints(matches, srcKey, object.keypoints);
 
         if (matches.empty()) { objInd++; continue; }
 
-        std::vector<RectProb> objRects = FindRectanglesFromMatchedPoints(points, object.size, this->srcImg.size(), object.keypoints.size(), nullptr);
+        std::vector<RectProb> objRects = FindRectanglesFromMatchedPoints(points, object.size, std::get<2>(srcIt->second), object.keypoints.size(), nullptr);
+        if (object.scale != 1) {
+            // Map the rectangles back to full resolution.
+            for (RectProb& rect : objRects) {
+                rect.x = cvRound(rect.x / object.scale); rect.y = cvRound(rect.y / object.scale);
+                rect.width = cvRound(rect.width / object.scale); rect.height = cvRound(rect.height / object.scale);
+            }
+            if (object.refine) { this->RefineRects(objRects, *object.refine); }
+        }
         result[objInd++] = objRects;
     }
     return result;
 }
 
+void ObjDetect::RefineRects(std::vector<RectProb>& rects, const ImageFeatures& fullResObject) const
+{
+    BenchmarkT<"RefineRects"> _b;
+    for (RectProb& rect : rects)
+    {
+        // Search the full resolution base image only around the coarse rectangle.
+        cv::Rect roi(rect.x - rect.width / 4, rect.y - rect.height / 4, rect.width * 3 / 2, rect.height * 3 / 2);
+        roi &= cv::Rect(0, 0, this->srcImg.cols, this->srcImg.rows);
+        if (roi.empty()) continue;
+
+        std::tuple<std::vector<cv::KeyPoint>, cv::Mat> roiKeyT = FindKeypoints(this->srcImg(roi), this->detector, &this->params);
+        std::vector<cv::DMatch> matches = MatchDescriptors(std::get<1>(roiKeyT), fullResObject.descriptors, this->matcher);
+        if (matches.empty()) continue;
+        std::tuple<std::vector<cv::Point2f>, std::vector<cv::Point2f>> points = GetMatchedPoints(matches, std::get<0>(roiKeyT), fullResObject.keypoints);
+        std::vector<RectProb> refined = FindRectanglesFromMatchedPoints(points, fullResObject.size, roi.size(), fullResObject.keypoints.size(), nullptr);
+        if (refined.empty()) continue; // Keep the coarse rectangle.
+
+        const RectProb& best = *std::max_element(refined.begin(), refined.end(), [](const RectProb& a, const RectProb& b) { return a.p < b.p; });
+        rect = RectProb((const cv::Rect&)best + roi.tl(), best.p);
+    }
+}
+
+ObjDetect::ColorHistogram::ColorHistogram(const cv::Mat& bgrImage)
+    : size(bgrImage.cols, bgrImage.rows)
+{
+    cv::Mat binImg = ColorHistogram::ToBinImage(bgrImage);
+    for (int y = 0; y < binImg.rows; y++) {
+        const uint8_t* row = binImg.ptr<uint8_t>(y);
+        for (int x = 0; x < binImg.cols; x++) { this->bins[row[x]]++; }
+    }
+    this->area = (float)binImg.total();
+}
+
+cv::Mat ObjDetect::ColorHistogram::ToBinImage(const cv::Mat& bgrImage)
+{
+    cv::Mat small, hsv;
+    cv::resize(bgrImage, small, cv::Size(), 1. / downscale, 1. / downscale, cv::INTER_AREA);
+    cv::cvtColor(small, hsv, cv::COLOR_BGR2HSV); // Accepts BGRA too.
+    cv::Mat binImg(hsv.size(), CV_8U);
+    for (int y = 0; y < hsv.rows; y++) {
+        const cv::Vec3b* in = hsv.ptr<cv::Vec3b>(y);
+        uint8_t* out = binImg.ptr<uint8_t>(y);
+        for (int x = 0; x < hsv.cols; x++) {
+            const uint8_t h = in[x][0], s = in[x][1], v = in[x][2];
+            if (v < 40 || s < 48) { out[x] = 16 + std::min(3, v / 64); } // Hue is meaningless for dark and unsaturated pixels.
+            else { out[x] = (h * 8 / 180) * 2 + (s >= 150); }
+        }
+    }
+    return binImg;
+}
+
+void ObjDetect::UpdateColorIntegral(const cv::Mat& bgrImage)
+{
+    BenchmarkT<"UpdateColorIntegral"> _b;
+    const int cellPx = 8; // Cell size at the downsampled resolution.
+    const int bins = ColorHistogram::binCount;
+    cv::Mat binImg = ColorHistogram::ToBinImage(bgrImage);
+    this->colorCells = cv::Size((binImg.cols + cellPx - 1) / cellPx, (binImg.rows + cellPx - 1) / cellPx);
+    const int stride = this->colorCells.width + 1;
+    this->colorIntegral.assign((this->colorCells.height + 1) * stride * bins, 0);
+
+    // Count pixels into the cell at (x+1, y+1), then sum up the cells.
+    for (int y = 0; y < binImg.rows; y++) {
+        const uint8_t* row = binImg.ptr<uint8_t>(y);
+        int* cellRow = &this->colorIntegral[(y / cellPx + 1) * stride * bins];
+        for (int x = 0; x < binImg.cols; x++) { cellRow[(x / cellPx + 1) * bins + row[x]]++; }
+    }
+    for (int cy = 1; cy <= this->colorCells.height; cy++) {
+        for (int cx = 1; cx <= this->colorCells.width; cx++) {
+            int* cur = &this->colorIntegral[(cy * stride + cx) * bins];
+            const int* left = cur - bins;
+            const int* up = cur - stride * bins;
+            const int* upLeft = up - bins;
+            for (int b = 0; b < bins; b++) { cur[b] += left[b] + up[b] - upLeft[b]; }
+        }
+    }
+}
+
+bool ObjDetect::ColorMayBePresent(const ColorHistogram& objColor, const cv::Rect& region) const
+{
+    if (objColor.area == 0 || this->colorIntegral.empty()) return true;
+    // The object only has to intersect the region, so extend the region with the object's size.
+    const int cellFullPx = 8 * ColorHistogram::downscale;
+    cv::Rect r(region.x - objColor.size.width, region.y - objColor.size.height, region.width + objColor.size.width * 2, region.height + objColor.size.height * 2);
+    int x0 = std::clamp(r.x / cellFullPx, 0, this->colorCells.width), x1 = std::clamp((r.br().x + cellFullPx - 1) / cellFullPx, 0, this->colorCells.width);
+    int y0 = std::clamp(r.y / cellFullPx, 0, this->colorCells.height), y1 = std::clamp((r.br().y + cellFullPx - 1) / cellFullPx, 0, this->colorCells.height);
+
+    const int bins = ColorHistogram::binCount, stride = this->colorCells.width + 1;
+    const int* i00 = &this->colorIntegral[(y0 * stride + x0) * bins];
+    const int* i01 = &this->colorIntegral[(y0 * stride + x1) * bins];
+    const int* i10 = &this->colorIntegral[(y1 * stride + x0) * bins];
+    const int* i11 = &this->colorIntegral[(y1 * stride + x1) * bins];
+    float matched = 0; // Histogram intersection: pixels of the object which can be covered by the region's pixels of the same bin.
+    for (int b = 0; b < bins; b++) {
+        matched += std::min<float>(i11[b] - i01[b] - i10[b] + i00[b], objColor.bins[b]);
+    }
+    return matched / objColor.area >= this->colorPrefilter;
+}
+
 void ObjDetect::SaveBaseImage(const std::string& filename)
 {
     cv::imwrite(filename, this->srcImg);
@@ -2,6 +2,9 @@
 
 #include <tuple>
 #include <vector>
+#include <memory>
+#include <array>
+#include <mutex>
 #include <opencv2/core.hpp>
 #include <opencv2/features2d.hpp>
 
@@ -48,20 +51,57 @@ public:
 		SIFT,
 		SIFT_BEBLID,
 	};
+	// Coarse hue / saturation / value histogram used to skip objects whose colours are not on the screen.
+	class ColorHistogram {
+	public:
+		static constexpr int binCount = 20; // 8 hues x 2 saturation levels + 4 gray levels.
+		static constexpr int downscale = 4; // Images are downsampled before counting.
+		std::array<float, binCount> bins{}; // Pixel counts at the downsampled resolution.
+		float area = 0; // 0 if the histogram is not calculated.
+		cv::Size size; // Full resolution size of the image.
+
+		ColorHistogram() {}
+		ColorHistogram(const cv::Mat& bgrImage);
+		static cv::Mat ToBinImage(const cv::Mat& bgrImage); // Downsampled image of bin indexes.
+	};
+	class DetectorParams;
 	class ImageFeatures {
 	public:
 		// Found keypoints and descriptors.
 		std::vector<cv::KeyPoint> keypoints;
 		cv::Mat descriptors;
 		cv::Size size;
+		float scale = 1; // Detection scale, the base image is downsampled with this factor before matching.
+		std::shared_ptr<ImageFeatures> refine; // Full resolution features for the refinement pass (only when scale < 1).
+		ColorHistogram color;
+		std::string source; // Image and settings the features were computed from, lets a config reload reuse them.
 
-		ImageFeatures(const cv::Mat& img, enum Detector detector);
+		ImageFeatures() {}
+		ImageFeatures(const cv::Mat& img, enum Detector detector, const DetectorParams* params = nullptr);
+	};
+	class FindObjectStats {
+	public:
+		size_t srcKeypoints = 0, objKeypoints = 0, matches = 0;
+	};
+	// Tunable parameters of the detector algorithms (see GetDetector).
+	class DetectorParams {
+	public:
+		int orbFeatures = 100000;
+		float orbScale = 1.1f;
+		int orbLevels = 16, orbEdgeThreshold = 8, orbPatchSize = 24, orbFastThreshold = 20;
+		int briskThreshold = 60, briskOctaves = 6;
+		float briskPatternScale = 1.0f;
+		double surfHessian = 100.0;
+		int surfOctaves = 4, surfLayers = 3;
+		float orbBeblidScale = 1.0f, briskBeblidScale = 5.f, surfBeblidScale = 6.25f, siftBeblidScale = 6.75f;
+
+		bool operator==(const DetectorParams&) const = default;
 	};
 
 	static cv::Mat PreprocessImage(const cv::Mat& image, const std::string& channel = "R"); // Converts RGB to single channel image.
 	static void PreprocessImageInplace(cv::Mat& image, const std::string& channel = "R");
 
-	static std::tuple <std::vector<cv::KeyPoint>, cv::Mat> FindKeypoints(const cv::Mat& image, enum Detector detector = Detector::ORB_BEBLID); // Detects keypoints and calculates descriptor on a single channel image. This is used by the keypoint matcher.
+	static std::tuple <std::vector<cv::KeyPoint>, cv::Mat> FindKeypoints(const cv::Mat& image, enum Detector detector = Detector::ORB_BEBLID, const DetectorParams* params = nullptr); // params: nullptr = the global ones. Detects keypoints and calculates descriptor on a single channel image. This is used by the keypoint matcher.
 	static std::vector<cv::DMatch> MatchDescriptors(const cv::Mat& descImg1, const cv::Mat& descImg2, cv::DescriptorMatcher::MatcherType matcher = cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING);
 	static std::tuple<std::vector<cv::Point2f>, std::vector<cv::Point2f>> GetMatchedPoints(const std::vector<cv::DMatch>& matches, const std::vector<cv::KeyPoint>& keyImg1, const std::vector<cv::KeyPoint>& keyImg2);
 	static std::tuple<cv::Mat, cv::Mat> GetTransformationMatrix(const std::tuple<std::vector<cv::Point2f>, std::vector<cv::Point2f>>& points);
@@ -72,21 +112,45 @@ public:
 	static void AddRectangleOrMerge(std::vector<RectProb>& rects, RectProb& rect);
 	static std::vector<RectProb> FindRectanglesFromMatchedPoints(std::tuple<std::vector<cv::Point2f>, std::vector<cv::Point2f>>& points, cv::Size objSize, cv::Size srcSize, size_t objKeypointCount, std::list<cv::Mat>* hList = nullptr);
 
-	static std::vector<RectProb> FindObject(const cv::Mat& srcImg, const cv::Mat& objImg, enum Detector detector = Detector::ORB_BEBLID, cv::DescriptorMatcher::MatcherType matcher = cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING, cv::Mat* debugImage = nullptr);
+	static std::vector<RectProb> FindObject(const cv::Mat& srcImg, const cv::Mat& objImg, enum Detector detector = Detector::ORB_BEBLID, cv::DescriptorMatcher::MatcherType matcher = cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING, cv::Mat* debugImage = nullptr, FindObjectStats* stats = nullptr);
+
+	ObjDetect(enum Detector detector = Detector::ORB_BEBLID, cv::DescriptorMatcher::MatcherType matcher = cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING, const std::string& channel = "R", const DetectorParams* params = nullptr); // params: nullptr = a copy of the global ones.
+	void SetScale(float scale, bool refine = false); // Default detection scale of the objects added after this call.
+	int AddObject(const cv::Mat& objImg, float scale = 0); // scale: 0 = use the default scale.
+	ImageFeatures ComputeObject(const cv::Mat& objImg, float scale = 0) const; // Features of AddObject, can be called from several threads.
+	int AddObject(ImageFeatures&& features);
+	std::string GetFeatureSettings(float scale = 0) const; // Every setting ComputeObject depends on besides the image, as text.
+	const std::list<ImageFeatures>& GetObjects() const { return this->objects; }
 
-	ObjDetect(enum Detector detector = Detector::ORB_BEBLID, cv::DescriptorMatcher::MatcherType matcher = cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING, const std::string& channel = "R");
-	int AddObject(const cv::Mat& objImg);
 	void UpdateBaseImage(cv::Mat&& srcImg);
-	std::vector < std::vector<RectProb> > FindObjects(const std::vector<bool>* objectMask = nullptr);
+	std::vector < std::vector<RectProb> > FindObjects(const std::vector<bool>* objectMask = nullptr, const std::vector<cv::Rect>* scanRects = nullptr);
+	void SetColorPrefilter(float minColorMatch) { this->colorPrefilter = minColorMatch; } // 0 disables the colour prefilter.
+	int GetSkippedObjectCount() const { return this->skippedObjects; } // Objects skipped by the colour prefilter in the last FindObjects call.
 
 	void SaveBaseImage(const std::string& filename);
 
+	// Global params of the static functions and of the instances created afterwards without own params.
+	static void SetDetectorParams(const DetectorParams& params);
+	static DetectorParams GetDetectorParams(); // A copy, the params may be set by another thread.
+
 private:
 	enum Detector detector;
 	cv::DescriptorMatcher::MatcherType matcher;
 	std::string channel;
+	DetectorParams params; // Fixed at construction, the global params may belong to another config.
 	cv::Mat srcImg;
 	std::list<ImageFeatures> objects;
+	float scale = 1;
+	bool refine = false;
+	float colorPrefilter = 0;
+	int skippedObjects = 0;
+	std::vector<int> colorIntegral; // Integral of per cell colour histograms: [(cellY * (cells.width + 1) + cellX) * binCount + bin].
+	cv::Size colorCells;
+
+	void UpdateColorIntegral(const cv::Mat& bgrImage);
+	bool ColorMayBePresent(const ColorHistogram& objColor, const cv::Rect& region) const;
+
+	void RefineRects(std::vector<RectProb>& rects, const ImageFeatures& fullResObject) const;
 
 	static void PreprocessImage(const cv::Mat& inImage, cv::Mat& outImage, const std::string& channel = "R");
 
@@ -94,8 +158,16 @@ private:
 		cv::Ptr<cv::FeatureDetector> detectAlgo;
 		cv::Ptr<cv::FeatureDetector> computeAlgo;
 	};
-	inline static std::vector<DetectorHolder> detectors;
-	static DetectorHolder GetDetector(enum Detector id);
+	struct CachedDetector {
+		enum Detector id;
+		DetectorParams params;
+		DetectorHolder holder;
+	};
+	// The detector algorithms are not thread-safe, every thread (loader, worker) creates its own instances.
+	inline static thread_local std::vector<CachedDetector> detectors;
+	inline static std::mutex detectorParamsMutex; // Guards detectorParams.
+	inline static DetectorParams detectorParams{};
+	static DetectorHolder GetDetector(enum Detector id, const DetectorParams& params);
 
 	inline static cv::Mat srcTemp;
 
@@ -0,0 +1,273 @@
+#include "StageBenchmark.h"
+#include "ObjDetect.h"
+#include "CoutSilencer.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include "../termcolor.hpp"
+#include "../magic_enum.hpp"
+#include "../scrcpy/util/yuv_convert.h"
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+static const std::vector<cv::Size> frameSizes{ {720, 1280}, {1080, 2400}, {1440, 3200} }; // Portrait device resolutions.
+
+StageBenchmark::StageBenchmark(int minIterations, int minTimeMs)
+	:minIterations(minIterations), minTimeMs(minTimeMs)
+{
+}
+
+// static
+cv::Mat StageBenchmark::GenerateFrame(const cv::Size& size, uint64_t seed)
+{
+	cv::RNG rng(seed);
+	cv::Mat frame(size, CV_8UC4);
+	for (int y = 0; y < frame.rows; y++) { // Vertical gradient background.
+		frame.row(y).setTo(cv::Scalar(40 + y * 60 / frame.rows, 30, 60 - y * 40 / frame.rows, 255));
+	}
+	const int shapeCount = size.area() / 20000;
+	for (int i = 0; i < shapeCount; i++) {
+		cv::Point p(rng.uniform(0, size.width), rng.uniform(0, size.height));
+		cv::Scalar color(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256), 255);
+		switch (rng.uniform(0, 4))
+		{
+		case 0: cv::rectangle(frame, cv::Rect(p, cv::Size(rng.uniform(20, 300), rng.uniform(20, 150))), color, rng.uniform(0, 2) ? cv::FILLED : 3); break;
+		case 1: cv::circle(frame, p, rng.uniform(8, 80), color, rng.uniform(0, 2) ? cv::FILLED : 2); break;
+		case 2: cv::line(frame, p, p + cv::Point(rng.uniform(-200, 200), rng.uniform(-200, 200)), color, rng.uniform(1, 6)); break;
+		default: cv::putText(frame, std::to_string(rng.uniform(0, 100000)), p, cv::FONT_HERSHEY_SIMPLEX, rng.uniform(0.5, 2.5), color, 2); break;
+		}
+	}
+	return frame;
+}
+
+// static
+std::vector<cv::Mat> StageBenchmark::CutObjects(const cv::Mat& frame, int count, uint64_t seed)
+{
+	cv::RNG rng(seed);
+	std::vector<cv::Mat> objects;
+	for (int i = 0; i < count; i++) {
+		cv::Size size(rng.uniform(120, 320), rng.uniform(60, 200));
+		cv::Point p(rng.uniform(0, frame.cols - size.width), rng.uniform(0, frame.rows - size.height));
+		objects.push_back(frame(cv::Rect(p, size)).clone());
+	}
+	return objects;
+}
+
+double StageBenchmark::Measure(const std::function<void()>& func) const
+{
+	func(); // Warm up (detector creation, allocations).
+	std::vector<double> times;
+	auto begin = std::chrono::steady_clock::now();
+	while (times.size() < (size_t)this->minIterations || std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(this->minTimeMs)) {
+		auto start = std::chrono::steady_clock::now();
+		func();
+		times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+		if (times.size() >= 1000) break;
+	}
+	std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+	return times[times.size() / 2];
+}
+
+void StageBenchmark::Add(const std::string& stage, const std::string& variant, const cv::Size& resolution, int param, const std::function<void()>& func)
+{
+	Entry& e = this->entries.emplace_back();
+	e.stage = stage; e.variant = variant; e.param = param; e.threads = cv::getNumThreads();
+	e.resolution = resolution.area() ? std::to_string(resolution.width) + 'x' + std::to_string(resolution.height) : "-";
+	e.medianUs = this->Measure(func);
+	e.relative = e.medianUs / this->referenceUs;
+	std::cout << "  " << e.stage << ' ' << e.variant << ' ' << e.resolution << ' ' << e.param << ": " << std::fixed << std::setprecision(1) << e.medianUs << " us\n";
+}
+
+void StageBenchmark::BenchYuvConvert(const cv::Mat& frame)
+{
+	// Decoded frames are YUV420P, compare the screen's frame conversion with the former sws_scale call.
+	cv::Mat yuv;
+	cv::cvtColor(frame, yuv, cv::COLOR_BGRA2YUV_I420);
+	const int w = frame.cols, h = frame.rows;
+	const uint8_t* data[3] = { yuv.data, yuv.data + w * h, yuv.data + w * h + (w / 2) * (h / 2) };
+	const int linesize[3] = { w, w / 2, w / 2 };
+	cv::Mat bgra(frame.size(), CV_8UC4), gray(frame.size(), CV_8UC1);
+
+	SwsContext* sws = sws_getContext(w, h, AV_PIX_FMT_YUV420P, w, h, AV_PIX_FMT_RGB32, SWS_POINT, nullptr, nullptr, nullptr);
+	this->Add("YuvConvert", "sws_scale-BGRA", frame.size(), 1, [&]() {
+		uint8_t* dst[1] = { bgra.data }; int dstStride[1] = { (int)bgra.step };
+		sws_scale(sws, data, linesize, 0, h, dst, dstStride);
+		});
+	sws_freeContext(sws);
+
+	for (int simd = SC_SIMD_NONE; simd <= yuv_convert_detect_simd(); simd++) {
+		const std::string name = yuv_convert_simd_name((sc_simd_level)simd);
+		for (bool parallel : { false, true }) {
+			const int threads = parallel ? cv::getNumThreads() : 1;
+			this->Add("YuvConvert", name + "-BGRA", frame.size(), threads, [&]() {
+				yuv420p_convert_planes(data, linesize, w, h, bgra.data, (int)bgra.step, SC_FRAME_FORMAT_BGRA, (sc_simd_level)simd, parallel);
+				});
+			this->Add("YuvConvert", name + "-Grayscale", frame.size(), threads, [&]() {
+				yuv420p_convert_planes(data, linesize, w, h, gray.data, (int)gray.step, SC_FRAME_FORMAT_GRAY, (sc_simd_level)simd, parallel);
+				});
+			this->Add("YuvConvert", name + "-G", frame.size(), threads, [&]() {
+				yuv420p_convert_planes(data, linesize, w, h, gray.data, (int)gray.step, SC_FRAME_FORMAT_G, (sc_simd_level)simd, parallel);
+				});
+		}
+	}
+}
+
+void StageBenchmark::BenchPreprocess(const cv::Mat& frame)
+{
+	for (const char* channel : { "R", "G", "B", "Grayscale", "H", "S", "V" }) {
+		this->Add("PreprocessImage", channel, frame.size(), 0, [&frame, channel]() { ObjDetect::PreprocessImage(frame, channel); });
+	}
+}
+
+void StageBenchmark::BenchKeypoints(const cv::Mat& frame1ch)
+{
+	for (ObjDetect::Detector detector : magic_enum::enum_values<ObjDetect::Detector>()) {
+		size_t keypoints = std::get<0>(ObjDetect::FindKeypoints(frame1ch, detector)).size();
+		this->Add("FindKeypoints", std::string(magic_enum::enum_name(detector)), frame1ch.size(), (int)keypoints, [&frame1ch, detector]() { ObjDetect::FindKeypoints(frame1ch, detector); });
+	}
+}
+
+void StageBenchmark::BenchMatchers(const cv::Mat& frame1ch, const cv::Mat& object1ch)
+{
+	using MT = cv::DescriptorMatcher::MatcherType;
+	const std::vector<std::tuple<ObjDetect::Detector, std::vector<MT>>> combinations{
+		{ ObjDetect::Detector::ORB_BEBLID, { MT::BRUTEFORCE_HAMMING, MT::BRUTEFORCE_HAMMINGLUT } },
+		{ ObjDetect::Detector::SIFT, { MT::BRUTEFORCE, MT::BRUTEFORCE_L1, MT::BRUTEFORCE_SL2, MT::FLANNBASED } } };
+	for (const auto& [detector, matchers] : combinations) {
+		cv::Mat srcDesc = std::get<1>(ObjDetect::FindKeypoints(frame1ch, detector));
+		cv::Mat objDesc = std::get<1>(ObjDetect::FindKeypoints(object1ch, detector));
+		for (int keypointCount : { 500, 2000, 8000, 32000 }) { // Keypoint count sweep on the frame side.
+			if (keypointCount > srcDesc.rows) break;
+			cv::Mat src = srcDesc.rowRange(0, keypointCount);
+			for (MT matcher : matchers) {
+				this->Add("MatchDescriptors", std::string(magic_enum::enum_name(matcher)), frame1ch.size(), keypointCount, [&src, &objDesc, matcher]() { ObjDetect::MatchDescriptors(src, objDesc, matcher); });
+			}
+		}
+	}
+}
+
+void StageBenchmark::BenchTransformation()
+{
+	cv::RNG rng(0x7a5f);
+	for (int pointCount : { 50, 200, 1000, 5000 }) {
+		// Half of the points follow a scale + translation, the rest are outliers.
+		std::tuple<std::vector<cv::Point2f>, std::vector<cv::Point2f>> points;
+		for (int i = 0; i < pointCount; i++) {
+			cv::Point2f obj(rng.uniform(0.f, 200.f), rng.uniform(0.f, 100.f));
+			cv::Point2f src = (i % 2) ? cv::Point2f(rng.uniform(0.f, 1080.f), rng.uniform(0.f, 2400.f)) : obj * 1.5f + cv::Point2f(300, 900);
+			std::get<0>(points).push_back(src);
+			std::get<1>(points).push_back(obj);
+		}
+		this->Add("GetTransformationMatrix", "RANSAC", cv::Size(), pointCount, [&points]() { ObjDetect::GetTransformationMatrix(points); });
+	}
+}
+
+void StageBenchmark::BenchRectangleMerge()
+{
+	cv::RNG rng(0x4ec7);
+	for (int rectCount : { 10, 100, 1000 }) {
+		std::vector<RectProb> input;
+		for (int i = 0; i < rectCount; i++) { input.emplace_back(cv::Rect(rng.uniform(0, 1000), rng.uniform(0, 2300), rng.uniform(20, 200), rng.uniform(20, 100)), 0.5f); }
+		this->Add("AddRectangleOrMerge", "random", cv::Size(), rectCount, [&input]() {
+			std::vector<RectProb> rects;
+			for (const RectProb& r : input) { RectProb rect = r; ObjDetect::AddRectangleOrMerge(rects, rect); }
+			});
+	}
+}
+
+void StageBenchmark::BenchObjectCount(const cv::Mat& frame)
+{
+	for (int objectCount : { 1, 8, 32 }) {
+		ObjDetect od(ObjDetect::Detector::ORB_BEBLID, cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING, "Grayscale");
+		for (const cv::Mat& object : StageBenchmark::CutObjects(frame, objectCount)) { od.AddObject(object); }
+		this->Add("FindObjects", "ORB_BEBLID", frame.size(), objectCount, [&od, &frame]() {
+			CoutSilencer silencer; // Silence the transformation matrix logging.
+			od.UpdateBaseImage(frame.clone());
+			od.FindObjects();
+			});
+	}
+}
+
+void StageBenchmark::BenchThreads(const cv::Mat& frame)
+{
+	const int originalThreads = cv::getNumThreads();
+	cv::Mat frame1ch = ObjDetect::PreprocessImage(frame, "Grayscale");
+	ObjDetect od(ObjDetect::Detector::ORB_BEBLID, cv::DescriptorMatcher::MatcherType::BRUTEFORCE_HAMMING, "Grayscale");
+	for (const cv::Mat& object : StageBenchmark::CutObjects(frame, 8)) { od.AddObject(object); }
+
+	for (int threads = 1; ; threads *= 2) {
+		threads = std::min(threads, cv::getNumberOfCPUs());
+		cv::setNumThreads(threads);
+		this->Add("FindKeypoints", "ORB_BEBLID", frame.size(), threads, [&frame1ch]() { ObjDetect::FindKeypoints(frame1ch, ObjDetect::Detector::ORB_BEBLID); });
+		this->Add("FindObjects", "ORB_BEBLID-8obj", frame.size(), threads, [&od, &frame]() {
+			CoutSilencer silencer; // Silence the transformation matrix logging.
+			od.UpdateBaseImage(frame.clone());
+			od.FindObjects();
+			});
+		if (threads >= cv::getNumberOfCPUs()) break;
+	}
+	cv::setNumThreads(originalThreads);
+}
+
+void StageBenchmark::Run()
+{
+	this->entries.clear();
+	std::cout << "OpenCV " << cv::getVersionString() << ", " << cv::getNumberOfCPUs() << " CPUs, " << cv::getNumThreads() << " threads.\n"
+		<< "CPU features: " << cv::getCPUFeaturesLine() << '\n';
+
+	// Reference workload: single threaded blur of a fixed image, the relative column is measured in these units.
+	{
+		const int originalThreads = cv::getNumThreads();
+		cv::setNumThreads(1);
+		cv::Mat refSrc = ObjDetect::PreprocessImage(StageBenchmark::GenerateFrame(cv::Size(1024, 1024)), "Grayscale"), refDst;
+		this->referenceUs = this->Measure([&refSrc, &refDst]() { cv::GaussianBlur(refSrc, refDst, cv::Size(7, 7), 0); });
+		cv::setNumThreads(originalThreads);
+		std::cout << "Reference workload: " << std::fixed << std::setprecision(1) << this->referenceUs << " us.\n";
+	}
+
+	for (const cv::Size& size : frameSizes) {
+		std::cout << termcolor::bright_white << "Frame " << size.width << 'x' << size.height << termcolor::reset << '\n';
+		cv::Mat frame = StageBenchmark::GenerateFrame(size);
+		cv::Mat frame1ch = ObjDetect::PreprocessImage(frame, "Grayscale");
+		cv::Mat object1ch = ObjDetect::PreprocessImage(StageBenchmark::CutObjects(frame, 1)[0], "Grayscale");
+		this->BenchYuvConvert(frame);
+		this->BenchPreprocess(frame);
+		this->BenchKeypoints(frame1ch);
+		this->BenchMatchers(frame1ch, object1ch);
+	}
+	std::cout << termcolor::bright_white << "Resolution independent stages" << termcolor::reset << '\n';
+	this->BenchTransformation();
+	this->BenchRectangleMerge();
+
+	cv::Mat frame = StageBenchmark::GenerateFrame(frameSizes[1]);
+	std::cout << termcolor::bright_white << "Object and thread count sweeps" << termcolor::reset << '\n';
+	this->BenchObjectCount(frame);
+	this->BenchThreads(frame);
+}
+
+void StageBenchmark::Print() const
+{
+	std::cout << std::left << std::setw(24) << "Stage" << std::setw(24) << "Variant" << std::setw(11) << "Frame" << std::right
+		<< std::setw(8) << "Param" << std::setw(8) << "Threads" << std::setw(14) << "Median us" << std::setw(10) << "Relative" << '\n';
+	for (const Entry& e : this->entries) {
+		std::cout << std::left << std::setw(24) << e.stage << std::setw(24) << e.variant << std::setw(11) << e.resolution << std::right
+			<< std::setw(8) << e.param << std::setw(8) << e.threads << std::setw(14) << std::fixed << std::setprecision(1) << e.medianUs
+			<< std::setw(10) << std::setprecision(3) << e.relative << '\n';
+	}
+}
+
+bool StageBenchmark::WriteCsv(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out) { std::cerr << "Cannot write benchmark results to " << path << ".\n"; return false; }
+	out << "stage,variant,frame,param,threads,median_us,relative\n";
+	for (const Entry& e : this->entries) {
+		out << e.stage << ',' << e.variant << ',' << e.resolution << ',' << e.param << ',' << e.threads << ',' << e.medianUs << ',' << e.relative << '\n';
+	}
+	std::cout << "Benchmark results written to " << path << ".\n";
+	return true;
+}
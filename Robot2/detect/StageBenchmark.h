@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <opencv2/core.hpp>
+
+// Micro-benchmarks of the ObjDetect stages on deterministic synthetic frames (started with the --bench-stages command line argument).
+// Every measurement is also given relative to a fixed single threaded reference workload, so reports of different machines can be compared.
+class StageBenchmark
+{
+public:
+	class Entry {
+	public:
+		std::string stage, variant, resolution;
+		int param, threads;
+		double medianUs, relative;
+	};
+private:
+	std::vector<Entry> entries;
+	double referenceUs = 0;
+	int minIterations, minTimeMs;
+
+	double Measure(const std::function<void()>& func) const; // Median time of a call in microseconds.
+
+	void BenchYuvConvert(const cv::Mat& frame);
+	void BenchPreprocess(const cv::Mat& frame);
+	void BenchKeypoints(const cv::Mat& frame1ch);
+	void BenchMatchers(const cv::Mat& frame1ch, const cv::Mat& object1ch);
+	void BenchTransformation();
+	void BenchRectangleMerge();
+	void BenchObjectCount(const cv::Mat& frame);
+	void BenchThreads(const cv::Mat& frame);
+public:
+	StageBenchmark(int minIterations = 5, int minTimeMs = 300);
+
+	static cv::Mat GenerateFrame(const cv::Size& size, uint64_t seed = 0x5eed); // BGRA frame with UI-like shapes and text.
+	static std::vector<cv::Mat> CutObjects(const cv::Mat& frame, int count, uint64_t seed = 0x0b1ec7);
+
+	void Run();
+	// Measures and records an entry, also used by the benchmarks outside of ObjDetect (after Run).
+	void Add(const std::string& stage, const std::string& variant, const cv::Size& resolution, int param, const std::function<void()>& func);
+	void Print() const;
+	bool WriteCsv(const std::string& path) const;
+};
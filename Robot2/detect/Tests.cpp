@@ -5,6 +5,9 @@
 #include <opencv2/imgproc.hpp>
 #include <numeric>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 #include "../termcolor.hpp"
 
 cv::Mat LoadImage(const std::string& imagePath)
@@ -84,87 +87,112 @@ void ObjDetectTest::RunTest()
 			const auto& matchers = (detector.second == "SURF" || detector.second == "SIFT") ? float_matchers : binary_matchers;
 			for (const std::pair<int, const char*> matcher : matchers)
 			{
-				float points = 0;
 				std::cout << "Test " << detector.second << " - " << matcher.second << " on " << imageChannel << '\n';
-				BenchmarkTCollector::Reset();
-				ObjDetect od;
-				std::vector<RectProb> result = od.FindObject(image1ch, obj1ch, (ObjDetect::Detector)detector.first, (cv::DescriptorMatcher::MatcherType)matcher.first);
-				
-				// Evaluate found rectangles.
-				std::list<int> testRectFoundPercent;
-				int foundAreas = 0, testAreas = 0, falseArea = 0, foundRects = 0, totalRects = 0;
-				falseArea = std::accumulate(result.begin(), result.end(), 0, [](size_t sum, const cv::Rect& r) { return sum + r.area(); });
-				for (const RectProb& testRect : this->objPlacesInImage)
-				{
-					std::vector<RectProb>::iterator maxCoveredRectIt = result.end();
-					int maxIntersectionArea = 0;
-					for (auto resRectIt = result.begin(); resRectIt != result.end(); ++resRectIt)
-					{
-						cv::Rect intersection = (*resRectIt & testRect);
-						int intersectionArea = intersection.area();
-						if (intersectionArea > maxIntersectionArea) {
-							maxCoveredRectIt = resRectIt;
-							maxIntersectionArea = intersectionArea;
-						}
-					}
-					int testRectArea = testRect.area();
-					testRectFoundPercent.push_back(maxIntersectionArea *100 / testRectArea);
-					foundAreas += maxIntersectionArea;
-					testAreas += testRectArea;
-					falseArea -= maxIntersectionArea;
-					if (maxIntersectionArea) {
-						foundRects++;
-					}
-					totalRects++;
-				}
-				const auto foundObjColor = (foundRects == totalRects) ? termcolor::bright_green : foundRects == 0 ? termcolor::bright_red : termcolor::bright_yellow;
-				std::cout << "Found objects: " << foundObjColor << foundRects << '/' << totalRects << termcolor::reset << ".\n";
-				if (testAreas) {
-					int foundAreaPercent = foundAreas * 100 / testAreas;
-					const auto foundAreaColor = (foundAreaPercent > 95) ? termcolor::bright_green : foundAreaPercent < 75 ? termcolor::bright_red : termcolor::bright_yellow;
-					std::cout << "Found object area: " << foundAreaColor << foundAreaPercent << " %" << termcolor::reset << ".\n";
-					int falseDetectPercent = falseArea * 100 / testAreas;
-					const auto falseDetectColor = (falseDetectPercent < 5) ? termcolor::bright_green : foundAreaPercent > 10 ? termcolor::bright_red : termcolor::bright_yellow;
-					std::cout << "False detection area / test: " << falseDetectColor << falseDetectPercent << " %" << termcolor::reset <<".\n";
-					points += std::max<float>(0, foundRects * 5. / totalRects + foundAreas * 5. / testAreas - falseDetectPercent/10); // All object found: 5p, None: 0p. 100% found by area: 5p, 0%: 0p. 10% false detection by area: -1p, 0%: 0p. Minimum is 0p.
-				}
-				else {
-					float falseDetectPercent = falseArea * 100 / (image.rows * image.cols);
-					const auto falseDetectColor = (falseDetectPercent == 0) ? termcolor::bright_green : falseDetectPercent > 5 ? termcolor::bright_red : termcolor::bright_yellow;
-					std::cout << "False detection area / image: " << falseDetectColor << falseDetectPercent << termcolor::reset << " %.\n";
-					points += std::max<float>(0, 5 - result.size() +(5*!result.size()) - falseArea * 100 / (image.rows * image.cols)); // 5p - 1p for each detected rectangle, +5p if nothing detected, 100% detected by image area: -100p, 0%: 0p. Minimum is 0p.
-				}
-				if (!testRectFoundPercent.empty()) {
-					std::cout << "Found rectangles: "; auto testRectFoundIt = testRectFoundPercent.begin();
-					std::cout << *testRectFoundIt++; 
-					for (; testRectFoundIt != testRectFoundPercent.end(); ++testRectFoundIt) std::cout << " %, " << *testRectFoundIt;
-					std::cout << " %.\n";
-				}
-				sumDetectPoints += points;
-				const auto detectPointColor = (points >= 9.5) ? termcolor::bright_green : points <= 7 ? termcolor::bright_red : termcolor::bright_yellow;
-				std::cout << "Detection points: " << detectPointColor << std::setprecision(2) << points << 'p' <<termcolor::reset<< ".\n";
-
-				// Get Benchmark.
-				std::map<std::string, std::tuple<long long, size_t>> bms = BenchmarkTCollector::Results();
-				int64_t totalTimeMs = std::get<0>(bms["FindObject"]) / 1000;
-				const auto totalTimeColor = (totalTimeMs < 100) ? termcolor::bright_green : (totalTimeMs < 200) ? termcolor::bright_white : termcolor::bright_yellow;
-				float timingPoints = (totalTimeMs < 10) ? 10 : (totalTimeMs < 200) ? ((200-totalTimeMs)*5./100) : 0;
-				std::cout << "Processing time: " << totalTimeColor << totalTimeMs << " ms " <<  std::setprecision(2) << timingPoints << 'p' << termcolor::reset
-					<<" (Image Keypoints: [Base: "<< std::get<0>(bms["FindKeypointsSrc"]) / 1000 <<" ms, Object: " << std::get<0>(bms["FindKeypointsObj"]) / 1000 <<" ms], Other: "<< (std::get<0>(bms["FindObject"]) - std::get<0>(bms["FindKeypointsSrc"]) - std::get<0>(bms["FindKeypointsObj"]))/1000 <<" ms).\n";
-				points += timingPoints;
-				sumTimingPoints += timingPoints;
-				std::cout << "Total points: " << std::setprecision(2) << points << 'p' << termcolor::reset << ".\n";
-				//BenchmarkTCollector::Print();
+				Result res = this->RunCase(image1ch, obj1ch, imageChannel, (ObjDetect::Detector)detector.first, (cv::DescriptorMatcher::MatcherType)matcher.first);
+				res.detector = detector.second; res.matcher = matcher.second;
+				sumDetectPoints += res.detectPoints;
+				sumTimingPoints += res.timingPoints;
 
 				// Save calculated points.
-				ObjDetectTest::totalPoints += points;
-				ObjDetectTest::AddPoint(imageChannel, detector.second, matcher.second, points- timingPoints, totalTimeMs);
+				ObjDetectTest::totalPoints += res.detectPoints + res.timingPoints;
+				ObjDetectTest::AddPoint(imageChannel, detector.second, matcher.second, res.detectPoints, res.findObjectUs / 1000);
+				ObjDetectTest::results.push_back(std::move(res));
 			}
 		}
 	}
 	std::cout << "Total points: " << std::fixed << std::setprecision(2) << (sumDetectPoints+sumTimingPoints) << " (Detect: " << std::setprecision(2) << sumDetectPoints <<", Timing: " << std::setprecision(2) << sumTimingPoints<< ").\n";
 }
 
+ObjDetectTest::Result ObjDetectTest::RunCase(const cv::Mat& image1ch, const cv::Mat& obj1ch, const std::string& imageChannel, ObjDetect::Detector detector, cv::DescriptorMatcher::MatcherType matcher) const
+{
+	float points = 0;
+	BenchmarkTCollector::Reset();
+	ObjDetect od;
+	ObjDetect::FindObjectStats stats;
+	std::vector<RectProb> result = od.FindObject(image1ch, obj1ch, detector, matcher, nullptr, &stats);
+	
+	// Evaluate found rectangles.
+	std::list<int> testRectFoundPercent;
+	int foundAreas = 0, testAreas = 0, falseArea = 0, foundRects = 0, totalRects = 0;
+	falseArea = std::accumulate(result.begin(), result.end(), 0, [](size_t sum, const cv::Rect& r) { return sum + r.area(); });
+	for (const RectProb& testRect : this->objPlacesInImage)
+	{
+		std::vector<RectProb>::iterator maxCoveredRectIt = result.end();
+		int maxIntersectionArea = 0;
+		for (auto resRectIt = result.begin(); resRectIt != result.end(); ++resRectIt)
+		{
+			cv::Rect intersection = (*resRectIt & testRect);
+			int intersectionArea = intersection.area();
+			if (intersectionArea > maxIntersectionArea) {
+				maxCoveredRectIt = resRectIt;
+				maxIntersectionArea = intersectionArea;
+			}
+		}
+		int testRectArea = testRect.area();
+		testRectFoundPercent.push_back(maxIntersectionArea *100 / testRectArea);
+		foundAreas += maxIntersectionArea;
+		testAreas += testRectArea;
+		falseArea -= maxIntersectionArea;
+		if (maxIntersectionArea) {
+			foundRects++;
+		}
+		totalRects++;
+	}
+	const auto foundObjColor = (foundRects == totalRects) ? termcolor::bright_green : foundRects == 0 ? termcolor::bright_red : termcolor::bright_yellow;
+	std::cout << "Found objects: " << foundObjColor << foundRects << '/' << totalRects << termcolor::reset << ".\n";
+	if (testAreas) {
+		int foundAreaPercent = foundAreas * 100 / testAreas;
+		const auto foundAreaColor = (foundAreaPercent > 95) ? termcolor::bright_green : foundAreaPercent < 75 ? termcolor::bright_red : termcolor::bright_yellow;
+		std::cout << "Found object area: " << foundAreaColor << foundAreaPercent << " %" << termcolor::reset << ".\n";
+		int falseDetectPercent = falseArea * 100 / testAreas;
+		const auto falseDetectColor = (falseDetectPercent < 5) ? termcolor::bright_green : foundAreaPercent > 10 ? termcolor::bright_red : termcolor::bright_yellow;
+		std::cout << "False detection area / test: " << falseDetectColor << falseDetectPercent << " %" << termcolor::reset <<".\n";
+		points += std::max<float>(0, foundRects * 5. / totalRects + foundAreas * 5. / testAreas - falseDetectPercent/10); // All object found: 5p, None: 0p. 100% found by area: 5p, 0%: 0p. 10% false detection by area: -1p, 0%: 0p. Minimum is 0p.
+	}
+	else {
+		float falseDetectPercent = falseArea * 100 / (image.rows * image.cols);
+		const auto falseDetectColor = (falseDetectPercent == 0) ? termcolor::bright_green : falseDetectPercent > 5 ? termcolor::bright_red : termcolor::bright_yellow;
+		std::cout << "False detection area / image: " << falseDetectColor << falseDetectPercent << termcolor::reset << " %.\n";
+		points += std::max<float>(0, 5 - result.size() +(5*!result.size()) - falseArea * 100 / (image.rows * image.cols)); // 5p - 1p for each detected rectangle, +5p if nothing detected, 100% detected by image area: -100p, 0%: 0p. Minimum is 0p.
+	}
+	if (!testRectFoundPercent.empty()) {
+		std::cout << "Found rectangles: "; auto testRectFoundIt = testRectFoundPercent.begin();
+		std::cout << *testRectFoundIt++; 
+		for (; testRectFoundIt != testRectFoundPercent.end(); ++testRectFoundIt) std::cout << " %, " << *testRectFoundIt;
+		std::cout << " %.\n";
+	}
+	const auto detectPointColor = (points >= 9.5) ? termcolor::bright_green : points <= 7 ? termcolor::bright_red : termcolor::bright_yellow;
+	std::cout << "Detection points: " << detectPointColor << std::setprecision(2) << points << 'p' <<termcolor::reset<< ".\n";
+
+	// Get Benchmark.
+	std::map<std::string, std::tuple<long long, size_t>> bms = BenchmarkTCollector::Results();
+	int64_t totalTimeMs = std::get<0>(bms["FindObject"]) / 1000;
+	const auto totalTimeColor = (totalTimeMs < 100) ? termcolor::bright_green : (totalTimeMs < 200) ? termcolor::bright_white : termcolor::bright_yellow;
+	float timingPoints = (totalTimeMs < 10) ? 10 : (totalTimeMs < 200) ? ((200-totalTimeMs)*5./100) : 0;
+	std::cout << "Processing time: " << totalTimeColor << totalTimeMs << " ms " <<  std::setprecision(2) << timingPoints << 'p' << termcolor::reset
+		<<" (Image Keypoints: [Base: "<< std::get<0>(bms["FindKeypointsSrc"]) / 1000 <<" ms, Object: " << std::get<0>(bms["FindKeypointsObj"]) / 1000 <<" ms], Other: "<< (std::get<0>(bms["FindObject"]) - std::get<0>(bms["FindKeypointsSrc"]) - std::get<0>(bms["FindKeypointsObj"]))/1000 <<" ms).\n";
+	points += timingPoints;
+	std::cout << "Total points: " << std::setprecision(2) << points << 'p' << termcolor::reset << ".\n";
+	//BenchmarkTCollector::Print();
+
+	Result res;
+	res.image = this->imagePath; res.object = this->objectPath; res.imageChannel = imageChannel;
+	res.detectPoints = points - timingPoints; res.timingPoints = timingPoints;
+	res.findObjectUs = std::get<0>(bms["FindObject"]);
+	res.findKeypointsSrcUs = std::get<0>(bms["FindKeypointsSrc"]);
+	res.findKeypointsObjUs = std::get<0>(bms["FindKeypointsObj"]);
+	res.srcKeypoints = stats.srcKeypoints; res.objKeypoints = stats.objKeypoints; res.matches = stats.matches;
+	res.foundRects = foundRects; res.totalRects = totalRects;
+	return res;
+}
+
+ObjDetectTest::Result ObjDetectTest::Evaluate(const std::string& channel, ObjDetect::Detector detector, cv::DescriptorMatcher::MatcherType matcher)
+{
+	if (this->image.empty()) { this->image = LoadImage(imagePath); }
+	if (this->object.empty()) { this->object = LoadImage(objectPath); }
+	return this->RunCase(ObjDetect::PreprocessImage(this->image, channel), ObjDetect::PreprocessImage(this->object, channel), channel, detector, matcher);
+}
+
 void ObjDetectTest::RunDownsampled(double scale)
 {
 	if (scale > 1) { std::cout << "RunDownsampled not upscaling.\n";  return; }
@@ -176,6 +204,8 @@ void ObjDetectTest::RunDownsampled(double scale)
 		std::list<cv::Rect> dObjPlaces;
 		for (const cv::Rect& objPlace : this->objPlacesInImage) { dObjPlaces.emplace_back(objPlace.x * scale, objPlace.y * scale, objPlace.width * scale, objPlace.height * scale); }
 		ObjDetectTest dTest(dImg, dObj, dObjPlaces);
+		std::string scaleStr = '@' + std::to_string(scale);
+		dTest.imagePath = this->imagePath + scaleStr; dTest.objectPath = this->objectPath + scaleStr;
 		dTest.RunTest();
 	}
 }
@@ -232,3 +262,163 @@ void ObjDetectTest::AddPoint(const std::string& name, std::map<std::string, std:
 		std::get<2>((*empRet.first).second) += 1;
 	}
 }
+
+static std::string CsvEscape(const std::string& text)
+{
+	if (text.find_first_of(",\"\n") == std::string::npos) return text;
+	std::string res = "\"";
+	for (char c : text) { if (c == '"') res += '"'; res += c; }
+	return res + '"';
+}
+static std::vector<std::string> CsvSplit(const std::string& line)
+{
+	std::vector<std::string> fields(1);
+	bool quoted = false;
+	for (size_t i = 0; i < line.size(); i++) {
+		char c = line[i];
+		if (quoted) {
+			if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') { fields.back() += '"'; i++; }
+			else if (c == '"') quoted = false;
+			else fields.back() += c;
+		}
+		else if (c == '"') quoted = true;
+		else if (c == ',') fields.emplace_back();
+		else if (c != '\r') fields.back() += c;
+	}
+	return fields;
+}
+static std::string JsonEscape(const std::string& text)
+{
+	std::string res;
+	for (char c : text) {
+		if (c == '"' || c == '\\') res += '\\';
+		res += c;
+	}
+	return res;
+}
+// Parses a flat JSON object written by WriteResults (one object per line, string or number values).
+static std::map<std::string, std::string> JsonSplit(const std::string& line)
+{
+	std::map<std::string, std::string> fields;
+	size_t pos = 0;
+	auto readString = [&line, &pos]() {
+		std::string res;
+		for (pos++; pos < line.size() && line[pos] != '"'; pos++) {
+			if (line[pos] == '\\' && pos + 1 < line.size()) pos++;
+			res += line[pos];
+		}
+		pos++;
+		return res;
+	};
+	while ((pos = line.find('"', pos)) != std::string::npos) {
+		std::string key = readString();
+		pos = line.find_first_not_of(" :", pos);
+		if (pos == std::string::npos) break;
+		if (line[pos] == '"') { fields[key] = readString(); }
+		else {
+			size_t end = line.find_first_of(",}", pos);
+			fields[key] = line.substr(pos, end - pos);
+			pos = end;
+		}
+	}
+	return fields;
+}
+
+static const std::vector<std::string> resultColumns{ "image", "object", "image_channel", "detector", "matcher", "detect_points", "timing_points",
+	"find_object_us", "find_keypoints_src_us", "find_keypoints_obj_us", "src_keypoints", "obj_keypoints", "matches", "found_rects", "total_rects" };
+
+static std::vector<std::string> ResultToFields(const ObjDetectTest::Result& r)
+{
+	return { r.image, r.object, r.imageChannel, r.detector, r.matcher, std::to_string(r.detectPoints), std::to_string(r.timingPoints),
+		std::to_string(r.findObjectUs), std::to_string(r.findKeypointsSrcUs), std::to_string(r.findKeypointsObjUs),
+		std::to_string(r.srcKeypoints), std::to_string(r.objKeypoints), std::to_string(r.matches), std::to_string(r.foundRects), std::to_string(r.totalRects) };
+}
+static ObjDetectTest::Result ResultFromFields(const std::map<std::string, std::string>& f)
+{
+	auto str = [&f](const char* key) { auto it = f.find(key); return it == f.end() ? std::string() : it->second; };
+	auto num = [&str](const char* key) { std::string v = str(key); return v.empty() ? 0. : std::stod(v); };
+	ObjDetectTest::Result r;
+	r.image = str("image"); r.object = str("object"); r.imageChannel = str("image_channel"); r.detector = str("detector"); r.matcher = str("matcher");
+	r.detectPoints = num("detect_points"); r.timingPoints = num("timing_points");
+	r.findObjectUs = num("find_object_us"); r.findKeypointsSrcUs = num("find_keypoints_src_us"); r.findKeypointsObjUs = num("find_keypoints_obj_us");
+	r.srcKeypoints = num("src_keypoints"); r.objKeypoints = num("obj_keypoints"); r.matches = num("matches");
+	r.foundRects = num("found_rects"); r.totalRects = num("total_rects");
+	return r;
+}
+
+// static
+bool ObjDetectTest::WriteResults(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out) { std::cerr << "Cannot write test results to " << path << ".\n"; return false; }
+	bool json = path.ends_with(".json");
+	if (!json) {
+		for (size_t i = 0; i < resultColumns.size(); i++) out << (i ? "," : "") << resultColumns[i];
+		out << '\n';
+	}
+	for (const Result& r : ObjDetectTest::results) {
+		std::vector<std::string> fields = ResultToFields(r);
+		for (size_t i = 0; i < fields.size(); i++) {
+			if (json) {
+				out << (i ? ", \"" : "{\"") << resultColumns[i] << "\": ";
+				if (i < 5) out << '"' << JsonEscape(fields[i]) << '"'; // The first 5 columns are strings.
+				else out << fields[i];
+			}
+			else { out << (i ? "," : "") << CsvEscape(fields[i]); }
+		}
+		out << (json ? "}\n" : "\n");
+	}
+	std::cout << "Test results written to " << path << " (" << ObjDetectTest::results.size() << " cases).\n";
+	return true;
+}
+
+// static
+std::list<ObjDetectTest::Result> ObjDetectTest::LoadResults(const std::string& path)
+{
+	std::list<Result> loaded;
+	std::ifstream in(path);
+	if (!in) { std::cerr << "Cannot read test results from " << path << ".\n"; return loaded; }
+	bool json = path.ends_with(".json");
+	std::vector<std::string> header;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() || line == "\r") continue;
+		if (json) { loaded.push_back(ResultFromFields(JsonSplit(line))); continue; }
+		std::vector<std::string> fields = CsvSplit(line);
+		if (header.empty()) { header = std::move(fields); continue; }
+		std::map<std::string, std::string> named;
+		for (size_t i = 0; i < fields.size() && i < header.size(); i++) named[header[i]] = fields[i];
+		loaded.push_back(ResultFromFields(named));
+	}
+	return loaded;
+}
+
+// static
+bool ObjDetectTest::CompareWithBaseline(const std::string& path, float maxTimeRegression, float maxPointDrop)
+{
+	const long long timeNoiseUs = 2000; // Differences below this are treated as measurement noise.
+	std::map<std::string, Result> baseline;
+	for (Result& r : ObjDetectTest::LoadResults(path)) { baseline.emplace(r.Key(), std::move(r)); }
+	if (baseline.empty()) { std::cerr << "Baseline " << path << " is empty.\n"; return false; }
+
+	int regressions = 0, compared = 0, missing = 0;
+	for (const Result& r : ObjDetectTest::results) {
+		auto it = baseline.find(r.Key());
+		if (it == baseline.end()) { missing++; continue; }
+		const Result& b = it->second;
+		compared++;
+		bool slower = r.findObjectUs > b.findObjectUs * (1 + maxTimeRegression) && r.findObjectUs - b.findObjectUs > timeNoiseUs;
+		bool worse = b.detectPoints - r.detectPoints > maxPointDrop;
+		if (!slower && !worse) continue;
+		regressions++;
+		std::cout << termcolor::bright_red << "Regression" << termcolor::reset << ": " << r.imageChannel << " / " << r.detector << " / " << r.matcher << " on " << r.image << " - " << r.object << ":";
+		if (slower) std::cout << " time " << b.findObjectUs / 1000 << " ms -> " << r.findObjectUs / 1000 << " ms";
+		if (worse) std::cout << " detection " << std::setprecision(2) << b.detectPoints << "p -> " << r.detectPoints << 'p';
+		std::cout << " (keypoints " << b.srcKeypoints << '/' << b.objKeypoints << " -> " << r.srcKeypoints << '/' << r.objKeypoints << ", matches " << b.matches << " -> " << r.matches << ").\n";
+	}
+	const auto color = regressions ? termcolor::bright_red : termcolor::bright_green;
+	std::cout << "Baseline comparison: " << color << regressions << " regressions" << termcolor::reset << " in " << compared << " cases";
+	if (missing) std::cout << " (" << missing << " cases not in baseline)";
+	std::cout << ".\n";
+	return regressions == 0;
+}
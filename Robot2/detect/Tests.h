@@ -4,9 +4,24 @@
 #include <list>
 #include <string>
 #include <opencv2/core.hpp>
+#include "ObjDetect.h"
 
 class ObjDetectTest
 {
+public:
+	// Measurements of a single image / object / channel / detector / matcher combination.
+	class Result
+	{
+	public:
+		std::string image, object, imageChannel, detector, matcher;
+		float detectPoints = 0, timingPoints = 0;
+		long long findObjectUs = 0, findKeypointsSrcUs = 0, findKeypointsObjUs = 0;
+		size_t srcKeypoints = 0, objKeypoints = 0, matches = 0;
+		int foundRects = 0, totalRects = 0;
+
+		std::string Key() const { return image + '|' + object + '|' + imageChannel + '|' + detector + '|' + matcher; }
+	};
+private:
 	cv::Mat image;
 	cv::Mat object;
 	const std::list<cv::Rect> objPlacesInImage;
@@ -20,15 +35,24 @@ public:
 	void RunTest();
 
 	void RunDownsampled(double scale);
+	// Runs a single detector / matcher combination on the given channel without recording it into the global stats.
+	Result Evaluate(const std::string& channel, ObjDetect::Detector detector, cv::DescriptorMatcher::MatcherType matcher);
 
 	inline static float totalPoints = 0;
 	inline static std::map<std::string, std::tuple<float, float, int>> imageChannelPoints{};
 	inline static std::map<std::string, std::tuple<float, float, int>> detectorPoints{};
 	inline static std::map<std::string, std::tuple<float, float, int>> matcherPoints{};
 	inline static std::map<std::string, std::tuple<float, float, int>> uniqueConfigPoints{};
+	inline static std::list<Result> results{};
 
 	static void DumpGlobalStats();
+	// Writes every collected result as CSV or as JSON lines (when the path ends with ".json").
+	static bool WriteResults(const std::string& path);
+	static std::list<Result> LoadResults(const std::string& path);
+	// Returns false when a test case got slower than (1 + maxTimeRegression) * baseline or lost more than maxPointDrop detection points.
+	static bool CompareWithBaseline(const std::string& path, float maxTimeRegression, float maxPointDrop);
 private:
+	Result RunCase(const cv::Mat& image1ch, const cv::Mat& obj1ch, const std::string& imageChannel, ObjDetect::Detector detector, cv::DescriptorMatcher::MatcherType matcher) const;
 	static void DumpStatMap(const std::string& name, const std::map<std::string, std::tuple<float, float, int>>& container, int limit=100);
 	static void AddPoint(const std::string& imageChannel, const std::string& detector, const std::string& matcher, float point, float timeMs);
 	static void AddPoint(const std::string& name, std::map<std::string, std::tuple<float, float, int>>& container, float point, float timeMs);
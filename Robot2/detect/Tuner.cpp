@@ -0,0 +1,215 @@
+#include "Tuner.h"
+#include "CoutSilencer.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "../termcolor.hpp"
+#include "../magic_enum.hpp"
+
+// Config keys and values of the parameters used by the given detector.
+static std::vector<std::pair<const char*, std::string>> ParamFields(const ObjDetect::DetectorParams& p, ObjDetect::Detector detector)
+{
+	auto f = [](float value) {
+		std::ostringstream ss; ss << value;
+		std::string res = ss.str();
+		if (res.find_first_of(".e") == std::string::npos) res += ".0"; // libconfig reads numbers without a dot as integers.
+		return res;
+	};
+	using D = ObjDetect::Detector;
+	std::vector<std::pair<const char*, std::string>> fields;
+	switch (detector)
+	{
+	case D::ORB_BEBLID:
+		fields.emplace_back("orb_beblid_scale", f(p.orbBeblidScale));
+		// not breaking.
+	case D::ORB:
+		fields.emplace_back("orb_features", std::to_string(p.orbFeatures));
+		fields.emplace_back("orb_scale", f(p.orbScale));
+		fields.emplace_back("orb_levels", std::to_string(p.orbLevels));
+		fields.emplace_back("orb_edge_threshold", std::to_string(p.orbEdgeThreshold));
+		fields.emplace_back("orb_patch_size", std::to_string(p.orbPatchSize));
+		fields.emplace_back("orb_fast_threshold", std::to_string(p.orbFastThreshold));
+		break;
+	case D::BRISK_BEBLID:
+		fields.emplace_back("brisk_beblid_scale", f(p.briskBeblidScale));
+		// not breaking.
+	case D::BRISK:
+		fields.emplace_back("brisk_threshold", std::to_string(p.briskThreshold));
+		fields.emplace_back("brisk_octaves", std::to_string(p.briskOctaves));
+		fields.emplace_back("brisk_pattern_scale", f(p.briskPatternScale));
+		break;
+	case D::SURF_BEBLID:
+		fields.emplace_back("surf_beblid_scale", f(p.surfBeblidScale));
+		// not breaking.
+	case D::SURF:
+		fields.emplace_back("surf_hessian", f(p.surfHessian));
+		fields.emplace_back("surf_octaves", std::to_string(p.surfOctaves));
+		fields.emplace_back("surf_layers", std::to_string(p.surfLayers));
+		break;
+	case D::SIFT_BEBLID:
+		fields.emplace_back("sift_beblid_scale", f(p.siftBeblidScale));
+		break;
+	default:
+		break;
+	}
+	return fields;
+}
+
+DetectorTuner::DetectorTuner(std::list<ObjDetectTest>& tests, ObjDetect::Detector detector, cv::DescriptorMatcher::MatcherType matcher, const std::string& channel, float latencyBudgetMs)
+	:detector(detector), matcher(matcher), channel(channel), latencyBudgetMs(latencyBudgetMs)
+{
+	for (ObjDetectTest& test : tests) { this->tests.push_back(&test); }
+}
+
+ObjDetect::DetectorParams DetectorTuner::RandomParams(std::mt19937& rng) const
+{
+	auto uniform = [&rng](float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); };
+	auto logUniform = [&uniform](float lo, float hi) { return std::exp(uniform(std::log(lo), std::log(hi))); };
+	auto integer = [&rng](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+
+	ObjDetect::DetectorParams p = ObjDetect::GetDetectorParams();
+	p.orbFeatures = (int)logUniform(500, 200000);
+	p.orbScale = uniform(1.05f, 1.6f);
+	p.orbLevels = integer(2, 16);
+	p.orbEdgeThreshold = integer(4, 31);
+	p.orbPatchSize = integer(8, 48);
+	p.orbFastThreshold = integer(5, 40);
+	p.briskThreshold = integer(10, 100);
+	p.briskOctaves = integer(0, 8);
+	p.briskPatternScale = uniform(0.5f, 2.f);
+	p.surfHessian = logUniform(50, 1000);
+	p.surfOctaves = integer(2, 6);
+	p.surfLayers = integer(2, 5);
+	// BEBLID scale factors are searched around their default values.
+	const ObjDetect::DetectorParams defaults;
+	p.orbBeblidScale = defaults.orbBeblidScale * logUniform(0.5f, 2.f);
+	p.briskBeblidScale = defaults.briskBeblidScale * logUniform(0.5f, 2.f);
+	p.surfBeblidScale = defaults.surfBeblidScale * logUniform(0.5f, 2.f);
+	p.siftBeblidScale = defaults.siftBeblidScale * logUniform(0.5f, 2.f);
+	return p;
+}
+
+void DetectorTuner::EvaluateCandidate(Candidate& candidate, size_t testCount)
+{
+	if (candidate.results.size() >= testCount) return;
+	ObjDetect::SetDetectorParams(candidate.params);
+	{
+		CoutSilencer silencer; // Silence the per-test output.
+		while (candidate.results.size() < testCount) {
+			candidate.results.push_back(this->tests[candidate.results.size()]->Evaluate(this->channel, this->detector, this->matcher));
+		}
+	}
+
+	float sumPoints = 0, sumTimeMs = 0;
+	for (const ObjDetectTest::Result& r : candidate.results) {
+		sumPoints += r.detectPoints;
+		sumTimeMs += r.findObjectUs / 1000.f;
+	}
+	candidate.detectPoints = sumPoints / candidate.results.size();
+	candidate.timeMs = sumTimeMs / candidate.results.size();
+}
+
+bool DetectorTuner::IsBetter(const Candidate& a, const Candidate& b) const
+{
+	bool aFits = this->latencyBudgetMs <= 0 || a.timeMs <= this->latencyBudgetMs;
+	bool bFits = this->latencyBudgetMs <= 0 || b.timeMs <= this->latencyBudgetMs;
+	if (aFits != bFits) return aFits;
+	if (!aFits) return a.timeMs < b.timeMs; // Both are over budget: prefer the faster one.
+	if (std::abs(a.detectPoints - b.detectPoints) > 0.01f) return a.detectPoints > b.detectPoints;
+	return a.timeMs < b.timeMs;
+}
+
+void DetectorTuner::Run(int sampleCount, unsigned int seed)
+{
+	this->candidates.clear();
+	this->finalists.clear();
+	if (this->tests.empty() || sampleCount <= 0) { std::cout << "Nothing to tune.\n"; return; }
+
+	const ObjDetect::DetectorParams originalParams = ObjDetect::GetDetectorParams();
+	std::mt19937 rng(seed);
+	this->candidates.emplace_back().params = originalParams; // Current parameters as reference.
+	while (this->candidates.size() < (size_t)sampleCount) { this->candidates.emplace_back().params = this->RandomParams(rng); }
+
+	std::vector<int> alive(this->candidates.size());
+	for (size_t i = 0; i < alive.size(); i++) alive[i] = (int)i;
+
+	// Choose the first round's test count so that the last round runs every test with at least 2 candidates left.
+	int rounds = 0;
+	while ((alive.size() >> (rounds + 1)) >= 2 && (this->tests.size() >> (rounds + 1)) >= 1) rounds++;
+	size_t roundTests = std::max<size_t>(1, this->tests.size() >> rounds);
+
+	std::cout << "Tuning " << magic_enum::enum_name(this->detector) << " / " << magic_enum::enum_name(this->matcher) << " on " << this->channel
+		<< " with " << this->candidates.size() << " candidates and " << this->tests.size() << " tests.\n";
+	while (true)
+	{
+		for (int ind : alive) { this->EvaluateCandidate(this->candidates[ind], roundTests); }
+		std::sort(alive.begin(), alive.end(), [this](int a, int b) { return this->IsBetter(this->candidates[a], this->candidates[b]); });
+		const Candidate& best = this->candidates[alive.front()];
+		std::cout << "  " << alive.size() << " candidates on " << roundTests << " tests, best: " << termcolor::bright_white
+			<< std::setprecision(3) << best.detectPoints << "p, " << best.timeMs << " ms" << termcolor::reset << ".\n";
+		if (roundTests >= this->tests.size()) break;
+		alive.resize(std::max<size_t>(2, alive.size() / 2));
+		roundTests = std::min(this->tests.size(), roundTests * 2);
+	}
+	this->finalists = alive;
+	ObjDetect::SetDetectorParams(originalParams);
+}
+
+std::vector<const DetectorTuner::Candidate*> DetectorTuner::GetParetoFront() const
+{
+	std::vector<const Candidate*> front;
+	for (int ind : this->finalists) {
+		const Candidate& c = this->candidates[ind];
+		bool dominated = std::any_of(this->finalists.begin(), this->finalists.end(), [this, &c](int otherInd) {
+			const Candidate& o = this->candidates[otherInd];
+			return o.detectPoints >= c.detectPoints && o.timeMs <= c.timeMs && (o.detectPoints > c.detectPoints || o.timeMs < c.timeMs);
+			});
+		if (!dominated) front.push_back(&c);
+	}
+	std::sort(front.begin(), front.end(), [](const Candidate* a, const Candidate* b) { return a->timeMs < b->timeMs; });
+	return front;
+}
+
+const DetectorTuner::Candidate* DetectorTuner::GetBest() const
+{
+	if (this->finalists.empty()) return nullptr;
+	return &this->candidates[*std::min_element(this->finalists.begin(), this->finalists.end(), [this](int a, int b) { return this->IsBetter(this->candidates[a], this->candidates[b]); })];
+}
+
+bool DetectorTuner::WriteParetoFront(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out) { std::cerr << "Cannot write Pareto front to " << path << ".\n"; return false; }
+	const Candidate* best = this->GetBest();
+	std::vector<const Candidate*> front = this->GetParetoFront();
+
+	out << "detect_points,find_object_ms,chosen";
+	for (const auto& [key, value] : ParamFields(ObjDetect::GetDetectorParams(), this->detector)) out << ',' << key;
+	out << '\n';
+	for (const Candidate* c : front) {
+		out << c->detectPoints << ',' << c->timeMs << ',' << (c == best);
+		for (const auto& [key, value] : ParamFields(c->params, this->detector)) out << ',' << value;
+		out << '\n';
+	}
+	std::cout << "Pareto front (" << front.size() << " entries) written to " << path << ".\n";
+	return true;
+}
+
+bool DetectorTuner::WriteConfig(const std::string& path) const
+{
+	const Candidate* best = this->GetBest();
+	if (!best) return false;
+	std::ofstream out(path);
+	if (!out) { std::cerr << "Cannot write tuned parameters to " << path << ".\n"; return false; }
+	out << "// Tuned for " << magic_enum::enum_name(this->detector) << " / " << magic_enum::enum_name(this->matcher) << " on " << this->channel
+		<< ": " << best->detectPoints << "p detection, " << best->timeMs << " ms.\n";
+	for (const auto& [key, value] : ParamFields(best->params, this->detector)) out << key << " = " << value << ";\n";
+
+	const auto color = (this->latencyBudgetMs <= 0 || best->timeMs <= this->latencyBudgetMs) ? termcolor::bright_green : termcolor::bright_yellow;
+	std::cout << "Chosen parameters: " << color << std::setprecision(3) << best->detectPoints << "p, " << best->timeMs << " ms" << termcolor::reset
+		<< ", written to " << path << ".\n";
+	return true;
+}
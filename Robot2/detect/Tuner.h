@@ -0,0 +1,43 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+#include <random>
+#include "ObjDetect.h"
+#include "Tests.h"
+
+// Searches ObjDetect::DetectorParams for a detector / matcher / channel using the scoring of ObjDetectTest.
+// Random candidates are evaluated with successive halving: every round runs the survivors on twice as many tests and keeps the better half.
+class DetectorTuner
+{
+public:
+	class Candidate {
+	public:
+		ObjDetect::DetectorParams params;
+		std::vector<ObjDetectTest::Result> results; // Results on the first results.size() tests.
+		float detectPoints = 0; // Average detection points (0-10).
+		float timeMs = 0; // Average FindObject time.
+	};
+private:
+	std::vector<ObjDetectTest*> tests;
+	ObjDetect::Detector detector;
+	cv::DescriptorMatcher::MatcherType matcher;
+	std::string channel;
+	float latencyBudgetMs;
+	std::vector<Candidate> candidates;
+	std::vector<int> finalists; // Candidates evaluated on every test.
+
+	ObjDetect::DetectorParams RandomParams(std::mt19937& rng) const;
+	void EvaluateCandidate(Candidate& candidate, size_t testCount);
+	bool IsBetter(const Candidate& a, const Candidate& b) const;
+public:
+	DetectorTuner(std::list<ObjDetectTest>& tests, ObjDetect::Detector detector, cv::DescriptorMatcher::MatcherType matcher, const std::string& channel, float latencyBudgetMs);
+
+	void Run(int sampleCount, unsigned int seed);
+	std::vector<const Candidate*> GetParetoFront() const; // Finalists not dominated in (detection points, time), sorted by time.
+	const Candidate* GetBest() const; // Most accurate finalist within the latency budget (or the fastest one if none fits).
+
+	bool WriteParetoFront(const std::string& path) const;
+	bool WriteConfig(const std::string& path) const; // Writes the chosen parameters as config lines (usable with @include).
+};
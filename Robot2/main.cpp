@@ -21,6 +21,9 @@ vcpkg install opencv[ffmpeg,contrib,nonfree,openmp,cuda]:x64-windows
 #include <opencv2/highgui.hpp>
 #include <opencv2/calib3d.hpp>
 #include <vector>
+#include <list>
+#include <atomic>
+#include <thread>
 #include <iostream>
 #include <filesystem>
 #include <opencv2/xfeatures2d.hpp>
@@ -52,12 +55,17 @@ vcpkg install opencv[ffmpeg,contrib,nonfree,openmp,cuda]:x64-windows
 #include "Benchmark.h"
 #include "detect/ObjDetect.h"
 #include "detect/Tests.h"
+#include "detect/Tuner.h"
+#include "detect/StageBenchmark.h"
 #include "Config.h"
 #include "Worker.h"
 #include "Environment.h"
 #include "Window.h"
+#include "DetectionScheduler.h"
+#include "Simulator.h"
 
 #include "scrcpy/scrcpy.h"
+#include "scrcpy/event_router.h"
 
 #include "DeviceFinder.h"
 
@@ -93,6 +101,53 @@ bool IsRunningFromCommandLine(char** envp)
     return result;
 }
 
+// Runs an Environment for every unused device, the detections of all devices share one thread pool.
+// configs[i] is used for the i-th device, the last one for the rest.
+int RunMultiDevice(Window& window, const std::vector<Config*>& configs)
+{
+    cv::setNumThreads(1); // The devices are detected in parallel instead.
+    DetectionScheduler scheduler(configs[0]->GetThreadCount());
+    EventRouter router;
+    EventRouter::active = &router;
+
+    std::list<std::string> serials;
+    std::list<void*> locks;
+    std::list<std::unique_ptr<Environment>> envs;
+    for (const std::string& devId : Device::List()) {
+        void* lock = Device::LockDevice(devId);
+        if (!lock) { std::cout << devId << " is used by another instance.\n"; continue; }
+        locks.push_back(lock);
+        serials.push_back(devId);
+        Server::PreparePush(devId.c_str());
+        Config& devConfig = *configs[std::min(envs.size(), configs.size() - 1)];
+        envs.push_back(std::make_unique<Environment>(window, devConfig, serials.back().c_str()));
+        envs.back()->SetScheduler(&scheduler);
+    }
+    std::cout << "Running " << envs.size() << " devices on " << scheduler.GetThreadCount() << " detection threads.\n";
+
+    std::atomic<size_t> running = envs.size();
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<Environment>& env : envs) {
+        threads.emplace_back([&env, &running] { env->Run(); running--; });
+    }
+    uint32_t lastReportMs = SDL_GetTicks();
+    while (running > 0) {
+        router.Dispatch(100);
+        if (SDL_GetTicks() - lastReportMs >= 10000) {
+            std::cout << scheduler.GetReport();
+            lastReportMs = SDL_GetTicks();
+        }
+    }
+    for (std::thread& thread : threads) thread.join();
+    std::cout << scheduler.GetReport();
+    BenchmarkTCollector::Print(); // Once, the probes are shared by the devices.
+
+    EventRouter::active = nullptr;
+    envs.clear();
+    for (void* lock : locks) CloseHandle(lock);
+    return 1;
+}
+
 int main(int argc, char* argv[], char** envp)
 {
 #ifdef _WIN32
@@ -104,7 +159,44 @@ int main(int argc, char* argv[], char** envp)
     bool runsFromCmd = IsRunningFromCommandLine(envp);
     if (!runsFromCmd) std::atexit(atexit_launched_without_console);
 
-    Window window;
+    if (argc > 1 && strcmp(argv[1], "--bench-stages") == 0) {
+        StageBenchmark bench;
+        bench.Run();
+        DecisionTable::Benchmark(bench);
+        bench.Print();
+        if (argc > 2) { bench.WriteCsv(argv[2]); }
+        return 0;
+    }
+
+    bool headless = false, multiDevice = false;
+    std::string simulateDir; double simulateHours = 0;
+    if (argc > 3 && strcmp(argv[1], "--simulate") == 0) { // Config run on recorded frames in virtual time.
+        simulateDir = argv[2];
+        simulateHours = atof(argv[3]);
+        argv[3] = argv[0];
+        argc -= 3; argv += 3;
+    }
+    if (argc > 1 && strcmp(argv[1], "--multi") == 0) { // Every unused device in one process, without window.
+        multiDevice = true;
+        argv[1] = argv[0];
+        argc--; argv++;
+    }
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0) { // Decode only for detection, without window.
+        headless = true;
+        argv[1] = argv[0];
+        argc--; argv++;
+    }
+    headless |= multiDevice || !simulateDir.empty(); // SDL has one event queue and window per process, the events are routed to the devices.
+
+    Window window(headless);
+
+    // The device is locked first, so the server push runs while the configs are loaded.
+    std::unique_ptr<Device> d;
+    if (!multiDevice && simulateDir.empty()) {
+        d = std::make_unique<Device>();
+        if (*d->GetDeviceId()) { Server::PreparePush(d->GetDeviceId()); }
+    }
+    const uint32_t configLoadStartMs = SDL_GetTicks();
     bool testOnlyConfig = true;
     if (argc > 1) {
         if (fs::exists(argv[1])) {
@@ -152,20 +244,53 @@ int main(int argc, char* argv[], char** envp)
             }
         }
     }
+    std::cout << "Configs loaded in " << SDL_GetTicks() - configLoadStartMs << " ms.\n";
+    if (testOnlyConfig && config.GetTuneOptions().samples > 0)
+    {
+        const Config::TuneOptions& tune = config.GetTuneOptions();
+        ObjDetect::SetDetectorParams(config.GetDetectorParams());
+        DetectorTuner tuner(config.Tests(), tune.detector, tune.matcher, tune.channel, tune.latencyBudgetMs);
+        tuner.Run(tune.samples, tune.seed);
+        tuner.WriteParetoFront(tune.paretoPath);
+        return tuner.WriteConfig(tune.outputPath) ? 0 : 1;
+    }
     if (testOnlyConfig)
     {
+        ObjDetect::SetDetectorParams(config.GetDetectorParams());
         for (ObjDetectTest& test : config.Tests())
         {
             test.RunTest();
         }
         ObjDetectTest::DumpGlobalStats();
+        if (!config.GetTestResultsPath().empty()) {
+            ObjDetectTest::WriteResults(config.GetTestResultsPath());
+        }
+        if (!config.GetTestBaselinePath().empty() &&
+            !ObjDetectTest::CompareWithBaseline(config.GetTestBaselinePath(), config.GetTestMaxTimeRegression(), config.GetTestMaxPointDrop())) {
+            return 2; // Detection got slower or less accurate than the baseline.
+        }
+    }
+    if (!simulateDir.empty()) {
+        Simulator simulator(config, simulateDir);
+        return simulator.Run(simulateHours) ? 0 : 1;
     }
+    if (multiDevice) {
+        std::list<Config> extraConfigs; // Configs of the further devices.
+        std::vector<Config*> configs{ &config };
+        for (int i = 2; i < argc; i++) {
+            if (!fs::exists(argv[i])) { printf("File %s doesn't exists!\n", argv[i]); return 1; }
+            extraConfigs.emplace_back().LoadConfig(argv[i]);
+            configs.push_back(&extraConfigs.back());
+        }
+        return RunMultiDevice(window, configs);
+    }
+
     Worker worker(config);
 
-    Device d;
-    std::cout << "Using device id: " << d.GetDeviceId() << std::endl;
+    std::cout << "Using device id: " << d->GetDeviceId() << std::endl;
 
-    Environment env(window, config, d.GetDeviceId());
+    Environment env(window, config, d->GetDeviceId());
     env.Run();
+    BenchmarkTCollector::Print();
     return 1;
 }
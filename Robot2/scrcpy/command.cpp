@@ -10,6 +10,8 @@
 #include "util/log.h"
 #include "util/str_util.h"
 
+#include <reproc/reproc.h>
+
 
 inline const char *
 get_adb_command(void)
@@ -214,6 +216,56 @@ adb_install(const char *serial, const char *local) {
     return proc;
 }
 
+bool
+adb_read_output(const char *serial, const char *const adb_cmd[], size_t len,
+                char *out, size_t out_size, int timeout_ms) {
+    const char *cmd[100 + 4];
+    int i = 0;
+    cmd[i++] = get_adb_command();
+    if (serial) {
+        cmd[i++] = "-s";
+        cmd[i++] = serial;
+    }
+    memcpy(&cmd[i], adb_cmd, len * sizeof(const char *));
+    cmd[len + i] = NULL;
+
+    reproc_t *process = reproc_new();
+    if (!process) {
+        return false;
+    }
+    reproc_options options = {};
+    options.redirect.err.type = REPROC_REDIRECT_DISCARD;
+    options.deadline = timeout_ms;
+    int r = reproc_start(process, cmd, options);
+    if (r < 0) {
+        LOGW("Could not execute \"%s\": %s", cmd[0], reproc_strerror(r));
+        reproc_destroy(process);
+        return false;
+    }
+    reproc_close(process, REPROC_STREAM_IN);
+
+    // read until the end of the output, the part not fitting is dropped
+    size_t total = 0;
+    char drop[256];
+    for (;;) {
+        bool full = total + 1 >= out_size;
+        r = reproc_read(process, REPROC_STREAM_OUT,
+                        (uint8_t *) (full ? drop : out + total),
+                        full ? sizeof(drop) : out_size - 1 - total);
+        if (r < 0) {
+            break; // REPROC_EPIPE at the end of the output
+        }
+        if (!full) {
+            total += r;
+        }
+    }
+    out[total] = '\0';
+
+    int status = reproc_wait(process, REPROC_DEADLINE);
+    reproc_destroy(process);
+    return status == 0;
+}
+
 bool
 process_check_success(process_t proc, const char *name) {
     if (proc == PROCESS_NONE) {
@@ -74,6 +74,12 @@ adb_push(const char* serial, const char* local, const char* remote);
 process_t
 adb_install(const char* serial, const char* local);
 
+// run an adb command and store the start of its stdout (nul-terminated) in
+// out, returns false if the command failed or did not finish in timeout_ms
+bool
+adb_read_output(const char* serial, const char* const adb_cmd[], size_t len,
+                char* out, size_t out_size, int timeout_ms);
+
 // convenience function to wait for a successful process execution
 // automatically log process errors with the provided process name
 bool
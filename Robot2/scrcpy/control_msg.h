@@ -10,6 +10,7 @@
 #include "android/input.h"
 #include "android/keycodes.h"
 #include "common.h"
+#include "../LatencyTrace.h"
 
 #define CONTROL_MSG_MAX_SIZE (1 << 18) // 256k
 
@@ -90,6 +91,10 @@ public:
             enum screen_power_mode mode;
         } set_screen_power_mode;
     };
+    // stages of the frame which caused an automated input, completed and
+    // recorded by the controller
+    FrameTiming timing;
+
     // buf size must be at least CONTROL_MSG_MAX_SIZE
     // return the number of bytes written
     size_t Serialize(unsigned char* buf) const;
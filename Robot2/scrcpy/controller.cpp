@@ -2,7 +2,7 @@
 #include <stdexcept>
 #include "util/lock.h"
 
-Controller::Controller(socket_t control_socket):receiver(control_socket)
+Controller::Controller(socket_t control_socket):receiver(control_socket), latency_trace(nullptr)
 {
     //cbuf_init(&this->queue);
 
@@ -40,7 +40,13 @@ bool Controller::ProcessMsg(const ControlMsg* msg) {
     if (!length) {
         return false;
     }
+    FrameTiming timing = msg->timing;
+    timing.serializedUs = LatencyTrace::NowUs();
     int w = net_send_all(this->control_socket, serialized_msg, length);
+    if (this->latency_trace && timing.actionUs && w == length) {
+        timing.sentUs = LatencyTrace::NowUs();
+        this->latency_trace->AddInput(timing);
+    }
     return w == length;
 }
 static int
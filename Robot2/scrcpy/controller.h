@@ -22,6 +22,7 @@ public:
     bool stopped;
     std::queue<ControlMsg> queue;//struct control_msg_queue queue;
     Receiver receiver;
+    LatencyTrace* latency_trace; // records the timing of the automated inputs, may be NULL
 
     Controller(socket_t control_socket);
     ~Controller();
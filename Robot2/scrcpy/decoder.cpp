@@ -4,8 +4,13 @@
 #include <SDL2/SDL_events.h>
 #include "compat.h"
 #include "events.h"
+#include "event_router.h"
+#include "../LatencyTrace.h"
+extern "C" {
+#include <libavutil/time.h>
+}
 
-Decoder::Decoder(VideoBuffer& video_buffer): video_buffer(video_buffer)
+Decoder::Decoder(VideoBuffer& video_buffer, const struct decoder_params& params): video_buffer(video_buffer), codec_ctx(nullptr), params(params), send_times(), send_times_index(0), event_owner(NULL), mode_name("default")
 {
 }
 
@@ -17,11 +22,32 @@ bool Decoder::Open(const AVCodec* codec)
         return false;
     }
 
+    this->codec_ctx->thread_count = this->params.threads;
+    this->codec_ctx->thread_type = this->params.thread_type == SC_DECODER_THREAD_FRAME ? FF_THREAD_FRAME : FF_THREAD_SLICE;
+    if (this->params.low_delay) {
+        if (this->params.thread_type == SC_DECODER_THREAD_FRAME && this->params.threads != 1) {
+            LOGW("Low delay decoding disables frame threading");
+        }
+        this->codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+    if (this->params.fast) {
+        this->codec_ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    }
+
     if (avcodec_open2(this->codec_ctx, codec, 0) < 0) {
         LOGE("Could not open codec");
         avcodec_free_context(&this->codec_ctx);
         return false;
     }
+    snprintf(this->mode_name, sizeof(this->mode_name), "%s threads: %d%s%s",
+        this->params.thread_type == SC_DECODER_THREAD_FRAME ? "frame" : "slice",
+        this->codec_ctx->thread_count,
+        this->params.low_delay ? ", low delay" : "",
+        this->params.fast ? ", fast" : "");
+    LOGI("Decoder: %s", this->GetModeName());
+    if (this->video_buffer.fps_counter) {
+        this->video_buffer.fps_counter->SetDecoderMode(this->GetModeName());
+    }
 
     return true;
 }
@@ -32,23 +58,39 @@ void Decoder::Close()
     avcodec_free_context(&this->codec_ctx);
 }
 
-bool Decoder::Push(const AVPacket* packet)
+bool Decoder::Push(const AVPacket* packet, int64_t recv_time_us)
 {
     // the new decoding/encoding API has been introduced by:
     // <http://git.videolan.org/?p=ffmpeg.git;a=commitdiff;h=7fc329e2dd6226dfecaa4a1d7adf353bf2773726>
 #ifdef SCRCPY_LAVF_HAS_NEW_ENCODING_DECODING_API
     int ret;
+    this->send_times[this->send_times_index] = { packet->pts, LatencyTrace::NowUs(), recv_time_us };
+    this->send_times_index = (this->send_times_index + 1) % DECODER_SEND_TIMES;
     if ((ret = avcodec_send_packet(this->codec_ctx, packet)) < 0) {
         LOGE("Could not send video packet: %d", ret);
         return false;
     }
 
-    ret = avcodec_receive_frame(this->codec_ctx, this->video_buffer.decoding_frame);
-    if (!ret) {
+    // with frame threading, a packet may release several frames
+    while (!(ret = avcodec_receive_frame(this->codec_ctx, this->video_buffer.decoding_frame))) {
         // a frame was received
+        FrameCounter* fps_counter = this->video_buffer.fps_counter;
+        int64_t pts = this->video_buffer.decoding_frame->pts;
+        int64_t now_us = LatencyTrace::NowUs();
+        this->video_buffer.decoding_timing = FrameTiming();
+        this->video_buffer.decoding_timing.decodedUs = now_us;
+        for (int i = 0; i < DECODER_SEND_TIMES; i++) {
+            if (this->send_times[i].pts == pts) {
+                this->video_buffer.decoding_timing.receiveUs = this->send_times[i].recv_us;
+                if (fps_counter) {
+                    fps_counter->AddDecodedFrame((uint32_t)(now_us - this->send_times[i].time_us));
+                }
+                break;
+            }
+        }
         this->PushFrame();
     }
-    else if (ret != AVERROR(EAGAIN)) {
+    if (ret != AVERROR(EAGAIN)) {
         LOGE("Could not receive video frame: %d", ret);
         return false;
     }
@@ -63,6 +105,9 @@ bool Decoder::Push(const AVPacket* packet)
         return false;
     }
     if (got_picture) {
+        this->video_buffer.decoding_timing = FrameTiming();
+        this->video_buffer.decoding_timing.receiveUs = recv_time_us;
+        this->video_buffer.decoding_timing.decodedUs = LatencyTrace::NowUs();
         this->PushFrame();
     }
 #endif
@@ -81,8 +126,5 @@ void Decoder::PushFrame()
         // the previous EVENT_NEW_FRAME will consume this frame
         return;
     }
-    static SDL_Event new_frame_event = {
-        .type = EVENT_NEW_FRAME,
-    };
-    SDL_PushEvent(&new_frame_event);
+    push_owned_event(EVENT_NEW_FRAME, this->event_owner);
 }
@@ -8,18 +8,46 @@ extern "C" {
 
 class VideoBuffer;
 
+enum sc_decoder_thread_type {
+    SC_DECODER_THREAD_SLICE,
+    SC_DECODER_THREAD_FRAME,
+};
+
+struct decoder_params {
+    int threads; // 0 = one per core
+    enum sc_decoder_thread_type thread_type;
+    bool low_delay; // AV_CODEC_FLAG_LOW_DELAY
+    bool fast; // AV_CODEC_FLAG2_FAST
+};
+
+#define DECODER_SEND_TIMES 32
+
 class Decoder {
 public:
     VideoBuffer& video_buffer;
     AVCodecContext* codec_ctx;
+    struct decoder_params params;
+
+    // send time of the recent packets, used to measure the decode latency
+    // (LatencyTrace::NowUs)
+    struct {
+        int64_t pts;
+        int64_t time_us;
+        int64_t recv_us;
+    } send_times[DECODER_SEND_TIMES];
+    unsigned send_times_index;
+    void* event_owner; // data1 of the pushed events, see EventRouter
+    char mode_name[64]; // set by Open
 
-    Decoder(VideoBuffer& video_buffer);
+    Decoder(VideoBuffer& video_buffer, const struct decoder_params& params);
     bool Open(const AVCodec* codec);
     void Close();
-    bool Push(const AVPacket* packet);
+    // recv_time_us: arrival of the packet, carried to the decoded frame
+    bool Push(const AVPacket* packet, int64_t recv_time_us = 0);
     void Interrupt();
 
     void PushFrame();
+    const char* GetModeName() const { return this->mode_name; }
 };
 
 #endif
@@ -0,0 +1,65 @@
+#include "event_router.h"
+
+#include <inttypes.h>
+
+#include "util/log.h"
+
+EventRouter* EventRouter::active = NULL;
+
+void EventRouter::Register(void* owner) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->queues[owner];
+}
+
+void EventRouter::Unregister(void* owner) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->queues.erase(owner);
+}
+
+bool EventRouter::Wait(void* owner, SDL_Event* event) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto it = this->queues.find(owner);
+    if (it == this->queues.end()) {
+        return false;
+    }
+    std::deque<SDL_Event>& queue = it->second;
+    this->queued.wait(lock, [&queue] { return !queue.empty(); });
+    *event = queue.front();
+    queue.pop_front();
+    return true;
+}
+
+void EventRouter::Dispatch(int timeout_ms) {
+    SDL_Event event;
+    if (!SDL_WaitEventTimeout(&event, timeout_ms)) {
+        return;
+    }
+    do {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (event.type == SDL_QUIT) {
+            for (auto& queue : this->queues) {
+                queue.second.push_back(event);
+            }
+        }
+        else if (event.type >= SDL_USEREVENT) {
+            auto it = this->queues.find(event.user.data1);
+            if (it != this->queues.end()) {
+                it->second.push_back(event);
+            }
+            else {
+                LOGD("Dropped event %" PRIu32 " of unknown owner", event.type);
+            }
+        }
+        // there is no window in multi-device mode, the other events are
+        // not meant for a device
+    } while (SDL_PollEvent(&event));
+    this->queued.notify_all();
+}
+
+void push_owned_event(uint32_t type, void* owner) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = type;
+    event.user.data1 = owner;
+    SDL_PushEvent(&event);
+}
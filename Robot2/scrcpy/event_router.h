@@ -0,0 +1,32 @@
+#ifndef EVENT_ROUTER_H
+#define EVENT_ROUTER_H
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <SDL2/SDL_events.h>
+
+// SDL has a single event queue per process. When several devices run in one
+// process, the main thread reads it and forwards the user events to the
+// event loop of their owner (event.user.data1), SDL_QUIT goes to every owner.
+class EventRouter {
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::map<void*, std::deque<SDL_Event>> queues;
+public:
+    static EventRouter* active; // NULL: every event loop reads SDL directly
+
+    void Register(void* owner);
+    void Unregister(void* owner);
+    // blocks until an event of the owner arrives
+    bool Wait(void* owner, SDL_Event* event);
+    // reads SDL events for at most timeout_ms and forwards them,
+    // must be called from the thread which initialized SDL
+    void Dispatch(int timeout_ms);
+};
+
+// pushes a user event which is routed back to its owner in multi-device mode
+void push_owned_event(uint32_t type, void* owner);
+
+#endif
@@ -302,7 +302,8 @@ void InputManager::ProcessTextInput(const SDL_TextInputEvent *event) {
     }
 }
 
-bool InputManager::SimulateVirtualFinger(enum android_motionevent_action action, struct point point) {
+bool InputManager::SimulateVirtualFinger(enum android_motionevent_action action, struct point point,
+                                         const FrameTiming* timing) {
     bool up = action == AMOTION_EVENT_ACTION_UP;
 
     ControlMsg msg;
@@ -313,6 +314,9 @@ bool InputManager::SimulateVirtualFinger(enum android_motionevent_action action,
     msg.inject_touch_event.pointer_id = POINTER_ID_VIRTUAL_FINGER;
     msg.inject_touch_event.pressure = up ? 0.0f : 1.0f;
     msg.inject_touch_event.buttons = (android_motionevent_buttons)0;
+    if (timing) {
+        msg.timing = *timing;
+    }
 
     if (!this->controller->PushMsg(std::move(msg))) {
         LOGW("Could not request 'inject virtual finger event'");
@@ -364,7 +368,10 @@ void InputManager::ProcessKey(const SDL_KeyboardEvent* event) {
     bool shift = event->keysym.mod & KMOD_SHIFT;
     bool repeat = event->repeat;
 
-    if (this->screen->ManageConsoleKey(keycode, event->keysym.scancode, event->keysym.mod, down)) return;
+    if (this->screen->ManageConsoleKey(keycode, event->keysym.scancode, event->keysym.mod, down)) {
+        this->screen->request_render();
+        return;
+    }
 
     // The shortcut modifier is pressed
     if (smod) {
@@ -735,11 +742,11 @@ void InputManager::ProcessMouseWheel(const SDL_MouseWheelEvent *event) {
     }
 }
 
-std::function<void(int, int, bool)> InputManager::GetTouchFunc()
+std::function<void(int, int, bool, const FrameTiming*)> InputManager::GetTouchFunc()
 {
-    std::function<void(int, int, bool)> result = [&](int x, int y, bool isDown) {
+    std::function<void(int, int, bool, const FrameTiming*)> result = [&](int x, int y, bool isDown, const FrameTiming* timing) {
         if (this->allowAutomatedInputs) {
-            this->SimulateVirtualFinger(isDown ? AMOTION_EVENT_ACTION_DOWN : AMOTION_EVENT_ACTION_UP, point{ x, y });
+            this->SimulateVirtualFinger(isDown ? AMOTION_EVENT_ACTION_DOWN : AMOTION_EVENT_ACTION_UP, point{ x, y }, timing);
         }
     };
     return result;
@@ -47,9 +47,11 @@ public:
     void ProcessMouseWheel(const SDL_MouseWheelEvent* event);
 
     bool IsShortcutMod(uint16_t sdl_mod);
-    bool SimulateVirtualFinger(enum android_motionevent_action action, struct point point);
+    // timing: stages of the frame which caused an automated input, NULL for the user's inputs
+    bool SimulateVirtualFinger(enum android_motionevent_action action, struct point point,
+                               const FrameTiming* timing = NULL);
 
-    std::function<void(int, int, bool)> GetTouchFunc();
+    std::function<void(int, int, bool, const FrameTiming*)> GetTouchFunc();
     void SetAutomatedInputsEnabled(bool enabled);
 };
 
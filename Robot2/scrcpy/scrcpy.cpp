@@ -2,9 +2,11 @@
 #include "util/log.h"
 #include "device.h"
 #include "events.h"
+#include "event_router.h"
 
 #include "../Environment.h"
 
+#include <algorithm>
 #include <SDL2/SDL.h>
 #ifdef _WIN32
 // not needed here, but winsock2.h must never be included AFTER windows.h
@@ -135,11 +137,17 @@ bool scrcpyOptions::Run()
         this->server = std::make_unique<Server>();
         //return false;
     }
+    this->startup.Restart();
+    this->server->startup = &this->startup;
 
     //InitRobot(&robot, &screen, &input_manager);
     //EstSetDeviceId(&robot.est, options->serial);
 
     bool ret = false;
+    if (EventRouter::active) {
+        // before anything can push an event of this device
+        EventRouter::active->Register(this);
+    }
 
     bool server_started = false;
     bool fps_counter_initialized = false;
@@ -190,6 +198,30 @@ bool scrcpyOptions::Run()
     if (!device_read_info(server->video_socket, device_name, &frame_size)) {
         goto end;
     }
+    this->device_size = frame_size;
+    this->startup.Mark("device info");
+
+    // the device size is only known once connected, so a stream scaled to a
+    // fraction of it needs a restart
+    if (this->stream_scale < 1 && !params.max_size) {
+        params.max_size = (uint16_t)(std::max(frame_size.width, frame_size.height) * this->stream_scale) & ~7;
+        LOGI("Restarting the server with max size %" PRIu16, params.max_size);
+        this->server->Stop();
+        this->server = std::make_unique<Server>();
+        this->server->startup = &this->startup;
+        this->startup.Mark("stop for restart");
+        if (!this->server->Start(this->serial, &params)) {
+            server_started = false;
+            goto end;
+        }
+        if (!this->server->ConnectTo()) {
+            goto end;
+        }
+        if (!device_read_info(server->video_socket, device_name, &frame_size)) {
+            goto end;
+        }
+        this->startup.Mark("device info");
+    }
 
     //struct decoder* dec = NULL;
     if (this->display) {
@@ -213,7 +245,8 @@ bool scrcpyOptions::Run()
             file_handler_initialized = true;
         }
 
-        this->decoder = std::make_unique<Decoder>(*this->video_buff); //decoder_init(&decoder, &video_buff);
+        this->decoder = std::make_unique<Decoder>(*this->video_buff, this->decoder_params); //decoder_init(&decoder, &video_buff);
+        this->decoder->event_owner = this;
         //dec = &decoder;
     }
 
@@ -230,6 +263,10 @@ bool scrcpyOptions::Run()
     av_log_set_callback(av_log_callback);
 
     this->stream = std::make_unique<Stream>(server->video_socket, this->decoder.get(), this->recorder.get()); //stream_init(&stream, server->video_socket, dec, rec);
+    this->stream->event_owner = this;
+    if (this->fps_counter) {
+        this->fps_counter->packet_pool = &this->stream->packet_pool;
+    }
 
     // now we consumed the header values, the socket receives the video stream
     // start the stream
@@ -244,6 +281,7 @@ bool scrcpyOptions::Run()
                 this->controller = std::make_unique<Controller>(server->control_socket);
                 //goto end;
             }
+            this->controller->latency_trace = this->latency_trace;
             controller_initialized = true;
 
             if (!controller->Start()) {
@@ -257,8 +295,14 @@ bool scrcpyOptions::Run()
         if (!this->screen.get()) {
             this->screen = std::make_unique<Screen>(*this->env->GetWindow());
         }
+        this->screen->frame_format = this->frame_format;
+        this->screen->event_owner = this;
+        this->screen->uploader.upload_bands = this->upload_bands;
 
-        if (!this->screen->init_rendering(window_title, frame_size,
+        if (this->headless) {
+            this->screen->init_headless(frame_size);
+        }
+        else if (!this->screen->init_rendering(window_title, frame_size,
             this->always_on_top, this->window_x,
             this->window_y, this->window_width,
             this->window_height,
@@ -266,6 +310,10 @@ bool scrcpyOptions::Run()
             this->rotation, this->mipmaps)) {
             goto end;
         }
+        else {
+            this->screen->fps_counter = this->fps_counter.get();
+            this->screen->set_idle_refresh(this->idle_refresh_fps);
+        }
         if (this->onWindowCreation) {
             this->onWindowCreation(this->screen.get(), frame_size);
         }
@@ -280,13 +328,14 @@ bool scrcpyOptions::Run()
             }
         }
 
-        if (this->fullscreen) {
+        if (this->fullscreen && !this->headless) {
             this->screen->switch_fullscreen();
         }
     }
     
     this->input_manager = std::make_unique<InputManager>(this, controller.get(), video_buff.get(), screen.get()); //input_manager_init(&input_manager, options);
     if (this->onInputManCreation) { this->onInputManCreation(this->input_manager.get()); }
+    this->startup.Mark("session setup");
 
     ret = this->EventLoop(); //options
     LOGD("quit...");
@@ -346,6 +395,9 @@ end:
 
     this->server.reset(); //server_destroy(&server);
 
+    if (EventRouter::active) {
+        EventRouter::active->Unregister(this);
+    }
     return ret;
 }
 
@@ -376,7 +428,9 @@ is_apk(const char* file) {
 enum event_result scrcpyOptions::HandleEvent(SDL_Event* event) {
     switch (event->type) {
     case EVENT_REFRESH:
-        this->screen->render(false);
+        if (this->screen->is_render_pending()) { // not rendered since the request
+            this->screen->render(false);
+        }
         break; 
     case EVENT_STREAM_STOPPED:
         LOGD("Video stream stopped");
@@ -386,6 +440,8 @@ enum event_result scrcpyOptions::HandleEvent(SDL_Event* event) {
         return EVENT_RESULT_STOPPED_BY_USER;
     case EVENT_NEW_FRAME:
         if (!this->screen->has_frame) {
+            this->startup.Mark("first frame");
+            this->startup.Print();
             screen->has_frame = true;
             // this is the very first frame, show the window
             screen->show_window();
@@ -453,12 +509,13 @@ enum event_result scrcpyOptions::HandleEvent(SDL_Event* event) {
 
 bool scrcpyOptions::EventLoop() {
 #ifdef CONTINUOUS_RESIZING_WORKAROUND
-    if (this->display) {
+    if (this->display && !this->headless) {
         SDL_AddEventWatch(event_watcher, this);
     }
 #endif
     SDL_Event event;
-    while (SDL_WaitEvent(&event)) {
+    EventRouter* router = EventRouter::active;
+    while (router ? router->Wait(this, &event) : SDL_WaitEvent(&event)) {
         enum event_result result = this->HandleEvent(&event);
         switch (result) {
         case EVENT_RESULT_STOPPED_BY_USER:
@@ -8,6 +8,7 @@
 #include <functional>
 
 #include "util/fps_counter.h"
+#include "util/startup_timer.h"
 #include "server.h"
 #include "screen.h"
 #include "video_buffer.h"
@@ -97,6 +98,15 @@ public:
     bool forward_key_repeat;
     bool forward_all_clicks;
     bool legacy_paste;
+    bool headless; // decode for the worker only: no window, GL context, console or overlay
+    unsigned idle_refresh_fps; // re-render without changes, 0: only on new frames, worker results, input and window events
+    bool upload_bands; // upload only the changed row bands of the frames
+    struct decoder_params decoder_params;
+    enum sc_frame_format frame_format;
+    float stream_scale; // < 1: restart the server with this fraction of the device size as max_size
+    struct size device_size; // native size, the frames are smaller if stream_scale < 1
+    LatencyTrace* latency_trace; // frame to touch latency of the automated inputs, may be NULL
+    StartupTimer startup; // phases until the first frame, printed when it arrives
 
     std::unique_ptr<Server> server;
     std::unique_ptr<Screen> screen;
@@ -142,6 +152,14 @@ public:
         forward_key_repeat(true),
         forward_all_clicks(false),
         legacy_paste(false),
+        headless(false),
+        idle_refresh_fps(0),
+        upload_bands(false),
+        decoder_params({.threads=1,.thread_type=SC_DECODER_THREAD_SLICE,.low_delay=false,.fast=false}),
+        frame_format(SC_FRAME_FORMAT_BGRA),
+        stream_scale(1),
+        device_size({.width=0,.height=0}),
+        latency_trace(nullptr),
         server(nullptr), screen(nullptr), fps_counter(nullptr), video_buff(nullptr), stream(nullptr), decoder(nullptr), recorder(nullptr), controller(nullptr), file_handler(nullptr), input_manager(nullptr),
         onWindowCreation(nullptr), onInputManCreation(nullptr)
         {}
@@ -8,6 +8,7 @@
 #include "scrcpy.h"
 #include "video_buffer.h"
 #include "events.h"
+#include "event_router.h"
 extern "C" {
     #include "util/tiny_xpm.h"
     #include "util/icon.xpm"
@@ -15,6 +16,7 @@ extern "C" {
 
 #include "../console/GLConsole.h"
 #include "../Worker.h"
+#include "../Benchmark.h"
 
 #define DISPLAY_MARGINS 96
 
@@ -297,6 +299,11 @@ GLuint Screen::create_texture()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, this->frame_size.width, this->frame_size.height,
         0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    if (sc_frame_format_channels(this->frame_format) == 1) {
+        // single channel frames are uploaded into the red component
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
 
 
     uint64_t psize = 4 * ((uint64_t)this->frame_size.width) * this->frame_size.height;
@@ -308,31 +315,55 @@ GLuint Screen::create_texture()
         glGenerateMipmap(GL_TEXTURE_2D);
     }
     free(pixels);
+    this->uploader.Init(this->frame_size, sc_frame_format_channels(this->frame_format));
     return resultTex;
 }
 
 uint32_t Screen::RefreshTimerCallback(uint32_t interval, void* param)
+{
+    ((Screen*)param)->request_render();
+    return interval;
+}
+
+uint32_t Screen::AnimationTimerCallback(uint32_t interval, void* param)
 {
     Screen* screen = (Screen*)param;
-    if (!screen->window || screen->frame_tex == -1) { return interval; }
-    uint32_t now = SDL_GetTicks();
-    if ((int)now - (int)screen->lastRender > (1000 / 25)) {
+    screen->animation_pending = false;
+    screen->request_render();
+    return 0; // one-shot
+}
 
-        static SDL_Event timer_update_event = {
-            .type = EVENT_REFRESH,
-        };
-        SDL_PushEvent(&timer_update_event);
-        screen->lastRender = now;
+void Screen::request_render()
+{
+    if (this->no_window || this->frame_tex == -1) {
+        return;
+    }
+    if (!this->render_pending.exchange(true)) {
+        push_owned_event(EVENT_REFRESH, this->event_owner);
+    }
+}
+
+void Screen::set_idle_refresh(unsigned fps)
+{
+    if (this->refreshTimer) {
+        SDL_RemoveTimer(this->refreshTimer);
+        this->refreshTimer = 0;
+    }
+    if (fps && !this->no_window) {
+        this->refreshTimer = SDL_AddTimer(1000 / fps, RefreshTimerCallback, this);
     }
-    return interval;
 }
 
 Screen::Screen(const Window& window) : Window(window), frame_tex(-1), vao(-1), vert_buf(-1), elem_buf(-1), tex_attrib(-1), vert_attrib(-1), /*gl(nullptr),*/ glcontext(nullptr),
 frame_size{ .width = 0,.height = 0 }, content_size{ .width = 0,.height = 0 }, resize_pending(false),
 windowed_content_size{ .width = 0,.height = 0 }, rotation(0), rect{.x=0,.y=0,.w=0,.h=0},
-has_frame(false),fullscreen(false),maximized(false),no_window(false),mipmaps(false), swsCtx(nullptr), lastRender(0), pixels{0}, worker(nullptr)
+has_frame(false),fullscreen(false),maximized(false),no_window(false),mipmaps(false), frame_format(SC_FRAME_FORMAT_BGRA), swsCtx(nullptr), converted(nullptr), converted_pts(-1),
+render_pending(false), animation_pending(false), refreshTimer(0), animationTimer(0), fps_counter(nullptr), event_owner(nullptr), worker(nullptr)
 {
-    this->refreshTimer = SDL_AddTimer(1000/25, RefreshTimerCallback, this);
+    if (!this->window) { // headless, nothing to refresh or show
+        this->no_window = true;
+        return;
+    }
     SDL_ShowWindow(this->window);
 }
 
@@ -342,10 +373,14 @@ Screen::~Screen()
     if (this->refreshTimer) {
         SDL_RemoveTimer(this->refreshTimer);
     }
+    if (this->animation_pending) {
+        SDL_RemoveTimer(this->animationTimer);
+    }
     if (this->glcontext) {
         if(this->frame_tex != -1) {
             SDL_GL_MakeCurrent(this->window, this->glcontext);
             glDeleteTextures(1, &this->frame_tex);
+            this->uploader.Destroy();
             //TODO: destroy other objects.
         }
         SDL_GL_DeleteContext(this->glcontext);
@@ -357,17 +392,23 @@ Screen::~Screen()
         sws_freeContext(this->swsCtx);
         this->swsCtx = NULL;
     }
-    if (this->pixels[0]) {
-        free(std::min(std::min(this->pixels[0], this->pixels[1]), this->pixels[2]));
-        this->pixels[0] = NULL;
-        this->pixels[1] = NULL;
-        this->pixels[2] = NULL;
+    if (this->uploader.nr_rows) {
+        LOGI("Texture upload: %.1f%% of the rows changed",
+            100.0 * this->uploader.nr_uploaded_rows / this->uploader.nr_rows);
     }
     /*if (this->detection.tapi) {
         DestroyDetection(&this->detection);
     }*/
 }
 
+void Screen::init_headless(struct size frame_size)
+{
+    this->no_window = true;
+    this->frame_size = frame_size;
+    this->content_size = Screen::get_rotated_size(frame_size, this->rotation);
+    LOGI("Headless mode, frames are only decoded for detection");
+}
+
 bool Screen::init_rendering(const char* window_title, size frame_size, bool always_on_top, int16_t window_x, int16_t window_y, uint16_t window_width, uint16_t window_height, bool window_borderless, uint8_t rotation, bool mipmaps)
 {
     this->frame_size = frame_size;
@@ -504,6 +545,9 @@ bool Screen::init_rendering(const char* window_title, size frame_size, bool alwa
 
 void Screen::show_window()
 {
+    if (this->no_window) {
+        return;
+    }
     SDL_ShowWindow(this->window);
 }
 
@@ -511,17 +555,19 @@ bool Screen::update_frame(VideoBuffer& vb)
 {
     mutex_lock(vb.mutex);
     const AVFrame* frame = vb.consume_rendered_frame();
+    this->converted_timing = vb.rendering_timing;
     struct size new_frame_size = { frame->width, frame->height };
     if (!this->prepare_for_frame(new_frame_size)) {
         mutex_unlock(vb.mutex);
         return false;
     }
     this->convert_frame(frame);
+    if (this->no_window) {
+        this->publish_frame();
+        mutex_unlock(vb.mutex);
+        return true;
+    }
     this->update_texture();
-    /*if (this->pixels_mutex.try_lock()) {
-        std::swap(this->pixels[0], this->pixels[1]);
-        this->pixels_mutex.unlock();
-    }*/
     mutex_unlock(vb.mutex);
 
     this->render(false);
@@ -531,7 +577,11 @@ bool Screen::update_frame(VideoBuffer& vb)
 
 void Screen::render(bool update_content_rect)
 {
-    this->lastRender = SDL_GetTicks();
+    if (this->no_window) {
+        return;
+    }
+    this->render_pending = false;
+    bool animating = this->console.IsOpen() || this->console.IsChanging(); // blinking cursor, sliding console
 
     if (update_content_rect) {
         this->update_content_rect();
@@ -567,7 +617,7 @@ void Screen::render(bool update_content_rect)
     //SDL_RenderPresent(this->renderer);*/
     SDL_GL_MakeCurrent(window, this->glcontext);
 
-    glClearColor(((SDL_GetTicks() / 16) % 256) / 256.0, 0, 0, 0);
+    glClearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
 
     glEnable(GL_TEXTURE_2D);
@@ -609,12 +659,9 @@ void Screen::render(bool update_content_rect)
         glDisable(GL_DEPTH_TEST);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        LockedBuffer<WorkerInfo> lb = this->worker->GetInfos().GetLast();
-        WorkerInfo& wi = lb.Get();
-        int oind = -1;
-        for (const std::vector<RectProb>& ds : wi.detections) {
-            oind++;
-            for (const RectProb& r : ds) {
+        const WorkerInfo& wi = this->worker->GetInfos().GetLast();
+        for (size_t oind = 0; oind < wi.GetObjectCount(); oind++) {
+            for (const RectProb& r : wi.GetDetections(oind)) {
                 if (r.p < 0.01) glColor4f(0, 0, 0, 0.1); // black
                 else if (r.isExcluded) glColor4f(0.47, 0.22, 0.44, 0.15); // purple
                 else if (r.p < 0.05) glColor4f(1, 0, 0, 0.2); // red
@@ -622,15 +669,15 @@ void Screen::render(bool update_content_rect)
                 glRectf(r.x, this->frame_size.height-r.y, r.x+r.width, this->frame_size.height-(r.y+r.height));
                 { 
                     glColor4f(0, 0, 0, 1);
-                    const std::string objName = this->worker->GetConfig().GetObjectName(oind);
                     this->console.GetFont().glPrintfFast(r.x, (this->frame_size.height - r.y)+2, 
-                        std::format("{:.1f}%% {}",r.p*100, objName));
+                        std::format("{:.1f}%% {}",r.p*100, wi.GetObjectName(oind)));
                 }
             }
         }
         if (!wi.clickRect.empty()) {
             uint32_t clickAge = SDL_GetTicks() - wi.lastClickTime;
             if (clickAge < 5000) {
+                animating = true;
                 glColor4f(0, 0, 1, (5000-clickAge)/(float)5000); // blue
                 glRectf(wi.clickRect.x, this->frame_size.height - wi.clickRect.y, wi.clickRect.x + wi.clickRect.width, this->frame_size.height - (wi.clickRect.y + wi.clickRect.height));
             }
@@ -689,6 +736,14 @@ void Screen::render(bool update_content_rect)
     glEnd();
     glFlush();*/
     SDL_GL_SwapWindow(window);  // Swap the window/buffer to display the result.
+    if (this->fps_counter) {
+        this->fps_counter->AddPresentedFrame();
+    }
+
+    // Changing overlays are redrawn at 25 fps until they settle.
+    if (animating && !this->animation_pending.exchange(true)) {
+        this->animationTimer = SDL_AddTimer(1000 / 25, AnimationTimerCallback, this);
+    }
 }
 
 void Screen::switch_fullscreen()
@@ -790,6 +845,15 @@ void Screen::set_rotation(unsigned rotation)
 
 // recreate the texture and resize the window if the frame size has changed
 bool Screen::prepare_for_frame(struct size new_frame_size) {
+    if (this->no_window) {
+        if (this->frame_size.width != new_frame_size.width
+            || this->frame_size.height != new_frame_size.height) {
+            this->frame_size = new_frame_size;
+            this->content_size = get_rotated_size(new_frame_size, this->rotation);
+            if (this->swsCtx) { sws_freeContext(this->swsCtx); this->swsCtx = NULL; }
+        }
+        return true;
+    }
     if (this->frame_size.width != new_frame_size.width
         || this->frame_size.height != new_frame_size.height) {
         // frame dimension changed, destroy texture
@@ -813,12 +877,6 @@ bool Screen::prepare_for_frame(struct size new_frame_size) {
         }
 
         if (this->swsCtx) { sws_freeContext(this->swsCtx); this->swsCtx = NULL; }
-        if (this->pixels[0]) {
-            free(std::min(std::min(this->pixels[0], this->pixels[1]), this->pixels[2]));
-            this->pixels[0] = NULL;
-            this->pixels[1] = NULL;
-            this->pixels[2] = NULL;
-        }
 
         //goto INIT_SWS;
     }
@@ -859,41 +917,63 @@ void Screen::update_texture() {
     //SDL_Rect rect = { 0,0,this->frame_size.width , this->frame_size.height };
     //SDL_UpdateTexture(this->texture, &rect, this->pixels, this->frame_size.width * 4);
 
+    if (!this->converted) {
+        return; // dropped, every slot is leased
+    }
+
+    BenchmarkT<"UploadTexture"> _b; // event thread, the collector is shared with the worker thread
     SDL_GL_MakeCurrent(window, this->glcontext);
     glEnable(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, this->frame_tex);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->frame_size.width,
-        this->frame_size.height, GL_BGRA, GL_UNSIGNED_BYTE,
-        this->pixels[0]);
+    GLenum upload_format = sc_frame_format_channels(this->frame_format) == 1 ? GL_RED : GL_BGRA;
+    bool changed = this->uploader.Upload(this->converted, upload_format);
 
-    if (this->mipmaps) {
+    if (this->mipmaps && changed) {
         //assert(this->use_opengl);
         //glBindTexture(GL_TEXTURE_2D, this->frame_tex); //SDL_GL_BindTexture(this->frame_tex, NULL, NULL);
         glGenerateMipmap(GL_TEXTURE_2D);
         //SDL_GL_UnbindTexture(this->frame_tex);
     }
 
-    std::lock_guard<std::mutex> lock(this->pixels_mutex);
-    std::swap(pixels[0], pixels[1]);
+    this->publish_frame();
+}
+
+void Screen::publish_frame()
+{
+    if (this->converted) {
+        this->frames.Publish(this->converted_pts, SDL_GetTicks(), this->converted_timing);
+        this->converted = NULL;
+    }
 }
 
 void Screen::convert_frame(const AVFrame* frame)
 {
-    if (!this->swsCtx) {
-        std::lock_guard<std::mutex> lock(this->pixels_mutex);
-        this->swsCtx = sws_getContext(frame->width,
-            frame->height, AV_PIX_FMT_YUV420P,
-            frame->width, frame->height, AV_PIX_FMT_RGB32,
-            SWS_POINT, NULL, NULL, NULL);
-        uint64_t psize = 4 * ((uint64_t)frame->width) * frame->height;
-        this->pixels[0] = (uint8_t*)malloc(psize*3 /*+100*/);
-        this->pixels[1] = ((uint8_t*)this->pixels[0]) + psize;
-        this->pixels[2] = ((uint8_t*)this->pixels[0]) + 2*psize;
+    this->converted_pts = frame->pts != AV_NOPTS_VALUE ? frame->pts : -1;
+    this->converted = this->frames.BeginWrite(frame->width, frame->height,
+        sc_frame_format_channels(this->frame_format));
+    if (!this->converted) { // counted by the frame ring
+        av_frame_unref((AVFrame*)frame);
+        return;
     }
 
-    uint8_t* rgb32[1] = { this->pixels[0] };
-    int rgb32_stride[1] = { 4 * this->frame_size.width };
-    sws_scale(this->swsCtx, frame->data, frame->linesize, 0, this->frame_size.height, rgb32, rgb32_stride);
+    if (!yuv420p_convert(frame, this->converted, this->frame_format)) {
+        if (!this->swsCtx) {
+            // swscale has no single color channel output, grayscale is the closest one
+            if (this->frame_format != SC_FRAME_FORMAT_BGRA && this->frame_format != SC_FRAME_FORMAT_GRAY) {
+                LOGW("Frame format %d is not YUV420P, converting to grayscale instead of %s",
+                    frame->format, sc_frame_format_name(this->frame_format));
+            }
+            this->swsCtx = sws_getContext(frame->width,
+                frame->height, (enum AVPixelFormat)frame->format,
+                frame->width, frame->height,
+                this->frame_format == SC_FRAME_FORMAT_BGRA ? AV_PIX_FMT_RGB32 : AV_PIX_FMT_GRAY8,
+                SWS_POINT, NULL, NULL, NULL);
+        }
+        uint8_t* dst[1] = { this->converted };
+        int dst_stride[1] = { sc_frame_format_channels(this->frame_format) * this->frame_size.width };
+        sws_scale(this->swsCtx, frame->data, frame->linesize, 0, this->frame_size.height, dst, dst_stride);
+    }
+    this->converted_timing.convertedUs = LatencyTrace::NowUs();
 
     av_frame_unref((AVFrame*)frame);//test
 }
@@ -910,22 +990,28 @@ std::tuple<uint8_t*, std::unique_lock<std::mutex>> Screen::GetLastImageFrame(Scr
     std::tuple<uint8_t*, std::unique_lock<std::mutex>> result{ screen->pixels[0vagy1], std::move(lock) };
     return result;
 }*/
-std::function<uint8_t*()> Screen::GetGrabImageFunc()
+std::function<FrameRing::FrameLease()> Screen::GetGrabImageFunc()
 {
-    std::function<uint8_t*()> result = std::bind(Screen::GetLastImageFrame, this);
-    return result;
+    return [this]() { return this->frames.Acquire(); };
 }
-uint8_t* Screen::GetLastImageFrame(Screen* screen)
+
+std::function<FrameRing::FrameLease(uint64_t, uint32_t)> Screen::GetWaitFrameFunc()
 {
-    //printf("Reading Last Screen Frame\n");
-    std::lock_guard<std::mutex> lock(screen->pixels_mutex);
-    std::swap(screen->pixels[1], screen->pixels[2]);
-    return screen->pixels[2];
+    return [this](uint64_t after_seq, uint32_t timeout_ms) {
+        return this->frames.WaitForFrame(after_seq,
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms));
+    };
 }
 
 void Screen::SetWorker(Worker* worker)
 {
+    if (this->worker) {
+        this->worker->GetInfos().SetOnCommit(nullptr);
+    }
     this->worker = worker;
+    if (this->worker) { // new detections and clicks are shown right away
+        this->worker->GetInfos().SetOnCommit([this]() { this->request_render(); });
+    }
 }
 
 void Screen::SetEnvironment(Environment* environment)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <functional>
 #include <SDL2/SDL.h>
@@ -10,9 +11,13 @@ extern "C" {
 }
 #include "config.h"
 #include "common.h"
+#include "util/yuv_convert.h"
+#include "util/fps_counter.h"
+#include "texture_upload.h"
 //#include "sc_opengl.h"
 #include "../console/GLConsole.h"
 #include "../Window.h"
+#include "../FrameRing.h"
 
 class VideoBuffer; class Worker; class Environment;
 
@@ -44,12 +49,22 @@ public:
     bool no_window;
     bool mipmaps;
 
-    struct SwsContext* swsCtx;
-    uint8_t* pixels[3];
-    std::mutex pixels_mutex; // Locks the usage of pixels[1].
-
-    uint32_t lastRender;
-    SDL_TimerID refreshTimer;
+    enum sc_frame_format frame_format; // format of the frames, single channel formats are shown as grayscale
+    struct SwsContext* swsCtx; // only for frames which are not YUV420P
+    FrameRing frames; // converted frames, leased by the worker
+    uint8_t* converted; // slot written by convert_frame, NULL if every slot is held
+    int64_t converted_pts;
+    FrameTiming converted_timing;
+    TextureUploader uploader; // streams the converted frames into frame_tex
+
+    // rendering is requested by new frames, worker commits, console input and
+    // window events, the requests are coalesced into one EVENT_REFRESH
+    std::atomic_bool render_pending;
+    std::atomic_bool animation_pending; // animationTimer is scheduled
+    SDL_TimerID refreshTimer; // optional idle refresh, 0 if disabled
+    SDL_TimerID animationTimer; // one-shot refresh while an overlay fades
+    FrameCounter* fps_counter; // counts the presented frames, may be NULL
+    void* event_owner; // data1 of the pushed events, see EventRouter
 
     Worker* worker;
     Environment* environment;
@@ -63,6 +78,10 @@ public:
     // destroy window, renderer and texture (if any)
     virtual ~Screen();
 
+    // initialize a screen without window for the headless mode: frames are
+    // only converted for the worker
+    void init_headless(struct size frame_size);
+
     // initialize screen, create window, renderer and texture (window is hidden)
     // window_x and window_y accept SC_WINDOW_POSITION_UNDEFINED
     bool
@@ -150,15 +169,23 @@ public:
 
     bool prepare_for_frame(struct size new_frame_size);
     void update_texture();
+    void publish_frame(); // make the converted frame the latest one of the frame ring
     void convert_frame(const AVFrame* frame);
 
-    // Update window when not receiving video frames for some time.
+    // request a render from any thread
+    void request_render();
+    bool is_render_pending() const { return this->render_pending; }
+    // re-render periodically even if nothing changed, 0 disables it
+    void set_idle_refresh(unsigned fps);
+
     static uint32_t RefreshTimerCallback(uint32_t interval, void* param);
+    static uint32_t AnimationTimerCallback(uint32_t interval, void* param);
 
     //std::function<std::tuple<uint8_t*, std::unique_lock<std::mutex>>()> GetGrabImageFunc();
     //static std::tuple<uint8_t*, std::unique_lock<std::mutex>> GetLastImageFrame(Screen* screen);
-    std::function<uint8_t*()> GetGrabImageFunc();
-    static uint8_t* GetLastImageFrame(Screen* screen);
+    std::function<FrameRing::FrameLease()> GetGrabImageFunc(); // leases the latest converted frame
+    // leases the first frame newer than the given sequence number, waits at most timeout_ms
+    std::function<FrameRing::FrameLease(uint64_t, uint32_t)> GetWaitFrameFunc();
     void SetWorker(Worker* worker);
     void SetEnvironment(Environment* environment);
 };
\ No newline at end of file
@@ -2,10 +2,17 @@
 #include "scrcpy.h"
 #include "compat.h"
 #include <cassert>
+#include <algorithm>
 #include <cinttypes>
 #include "util/lock.h"
 #include "util/str_util.h"
+#include "util/sha256.h"
+#include "util/startup_timer.h"
 #include <SDL2/SDL_timer.h>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
 //#include <SDL2/SDL_platform.h>
 
 #define SOCKET_NAME "scrcpy"
@@ -82,6 +89,31 @@ get_server_path(void) {
 #endif
 }
 
+// the server jar does not change while running, hash it once
+static const char*
+get_server_hash(const char* server_path) {
+    static std::once_flag once;
+    static char hash[SHA256_HEX_LENGTH + 1] = "";
+    std::call_once(once, [server_path] {
+        if (!sha256_file_hex(server_path, hash)) {
+            hash[0] = '\0';
+        }
+    });
+    return hash[0] ? hash : NULL;
+}
+
+// true if the device already has the same server jar
+static bool
+is_server_on_device(const char* serial, const char* server_hash) {
+    const char* const adb_cmd[] = {"shell", "sha256sum", DEVICE_SERVER_PATH};
+    char output[128];
+    if (!adb_read_output(serial, adb_cmd, ARRAY_LEN(adb_cmd), output,
+                         sizeof(output), 5000)) {
+        return false; // missing file, or no sha256sum on old devices
+    }
+    return !strncmp(output, server_hash, SHA256_HEX_LENGTH);
+}
+
 // static
 bool Server::PushServer(const char* serial) {
     char* server_path = get_server_path();
@@ -93,11 +125,46 @@ bool Server::PushServer(const char* serial) {
         SDL_free(server_path);
         return false;
     }
+    const char* server_hash = get_server_hash(server_path);
+    if (server_hash && is_server_on_device(serial, server_hash)) {
+        LOGD("The server on the device is up to date, skipping the push");
+        SDL_free(server_path);
+        return true;
+    }
     process_t process = adb_push(serial, server_path, DEVICE_SERVER_PATH);
     SDL_free(server_path);
     return process_check_success(process, "adb push");
 }
 
+// pushes started by PreparePush(), by serial ("" if none)
+static std::mutex pending_pushes_mutex;
+static std::map<std::string, std::shared_future<bool>> pending_pushes;
+
+// static
+void Server::PreparePush(const char* serial) {
+    std::string key = serial ? serial : "";
+    std::shared_future<bool> push = std::async(std::launch::async, [key] {
+        return Server::PushServer(key.empty() ? NULL : key.c_str());
+    }).share();
+    std::lock_guard<std::mutex> lock(pending_pushes_mutex);
+    pending_pushes[key] = push;
+}
+
+// uses the push started by PreparePush() if there is one
+static bool
+finish_push(const char* serial) {
+    std::shared_future<bool> push;
+    {
+        std::lock_guard<std::mutex> lock(pending_pushes_mutex);
+        auto it = pending_pushes.find(serial ? serial : "");
+        if (it != pending_pushes.end()) {
+            push = it->second;
+            pending_pushes.erase(it);
+        }
+    }
+    return push.valid() ? push.get() : Server::PushServer(serial);
+}
+
 // static
 bool Server::EnableTunnelReverse(const char* serial, uint16_t local_port) {
     process_t process = adb_reverse(serial, SOCKET_NAME, local_port);
@@ -369,20 +436,26 @@ connect_and_read_byte(uint16_t port) {
     return socket;
 }
 
+// the server usually listens within a few dozen ms, so poll often at first
+// and back off exponentially up to max_delay
 static socket_t
-connect_to_server(uint16_t port, uint32_t attempts, uint32_t delay) {
-    do {
-        LOGD("Remaining connection attempts: %d", (int)attempts);
+connect_to_server(uint16_t port, uint32_t timeout_ms, uint32_t max_delay) {
+    uint32_t start = SDL_GetTicks();
+    uint32_t delay = 5; // ms
+    for (;;) {
         socket_t socket = connect_and_read_byte(port);
         if (socket != INVALID_SOCKET) {
             // it worked!
             return socket;
         }
-        if (attempts) {
-            SDL_Delay(delay);
+        uint32_t elapsed = SDL_GetTicks() - start;
+        if (elapsed >= timeout_ms) {
+            return INVALID_SOCKET;
         }
-    } while (--attempts > 0);
-    return INVALID_SOCKET;
+        LOGD("Server not listening yet, retrying in %" PRIu32 " ms", delay);
+        SDL_Delay(std::min(delay, timeout_ms - elapsed));
+        delay = std::min(delay * 2, max_delay);
+    }
 }
 
 static void
@@ -424,6 +497,7 @@ Server::Server()
 
     this->tunnel_enabled = false;
     this->tunnel_forward = false;
+    this->startup = NULL;
 }
 
 Server::~Server()
@@ -470,19 +544,28 @@ bool Server::Start(const char* serial, const server_params* params)
         }
     }
 
-    if (!Server::PushServer(serial)) {
+    if (!finish_push(serial)) {
         goto error1;
     }
+    if (this->startup) {
+        this->startup->Mark("push server");
+    }
 
     if (!this->EnableTunnelAnyPort(params->port_range, params->force_adb_forward)) {
         goto error1;
     }
+    if (this->startup) {
+        this->startup->Mark("adb tunnel");
+    }
 
     // server will connect to our server socket
     this->process = this->ExecuteServer(params);
     if (this->process == PROCESS_NONE) {
         goto error2;
     }
+    if (this->startup) {
+        this->startup->Mark("start server");
+    }
 
     // If the server process dies before connecting to the server socket, then
     // the client will be stuck forever on accept(). To avoid the problem, we
@@ -542,10 +625,10 @@ bool Server::ConnectTo()
         }
     }
     else {
-        uint32_t attempts = 100;
-        uint32_t delay = 100; // ms
+        uint32_t timeout = 10000; // ms
+        uint32_t max_delay = 200; // ms
         this->video_socket =
-            connect_to_server(this->local_port, attempts, delay);
+            connect_to_server(this->local_port, timeout, max_delay);
         if (this->video_socket == INVALID_SOCKET) {
             return false;
         }
@@ -558,6 +641,10 @@ bool Server::ConnectTo()
         }
     }
 
+    if (this->startup) {
+        this->startup->Mark("connect");
+    }
+
     // we don't need the adb tunnel anymore
     this->DisableTunnel(); // ignore failure
     this->tunnel_enabled = false;
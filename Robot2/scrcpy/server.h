@@ -14,6 +14,8 @@ extern "C" {
 #include "util/net.h"
 }
 
+class StartupTimer;
+
 class Server {
 public:
     char* serial;
@@ -32,6 +34,7 @@ public:
     uint16_t local_port; // selected from port_range
     bool tunnel_enabled;
     bool tunnel_forward; // use "adb forward" instead of "adb reverse"
+    StartupTimer* startup; // marks the phases of Start and ConnectTo, may be NULL
 
     // init default values
     Server();
@@ -52,7 +55,11 @@ public:
     bool EnableTunnelForwardAnyPort(struct port_range port_range);
     bool EnableTunnelAnyPort(struct port_range port_range, bool force_adb_forward);
 
+    // push the server jar, skipped if the device has the same one
     static bool PushServer(const char* serial);
+    // start the push in the background, the next Start() for the serial
+    // waits for it instead of pushing again
+    static void PreparePush(const char* serial);
     static bool EnableTunnelReverse(const char* serial, uint16_t local_port);
     static bool DisableTunnelReverse(const char* serial);
     static bool EnableTunnelForward(const char* serial, uint16_t local_port);
@@ -14,9 +14,11 @@ extern "C" {
 #include "compat.h"
 #include "decoder.h"
 #include "events.h"
+#include "event_router.h"
 #include "recorder.h"
 #include "util/buffer_util.h"
 #include "util/log.h"
+#include "../LatencyTrace.h"
 
 #define BUFSIZE 0x10000
 
@@ -45,15 +47,23 @@ stream_recv_packet(Stream* stream, AVPacket *packet) {
 
     uint64_t pts = buffer_read64be(header);
     uint32_t len = buffer_read32be(&header[8]);
+    if (pts != NO_PTS) {
+        stream->recv_time_us = LatencyTrace::NowUs();
+    }
     assert(pts == NO_PTS || (pts & 0x8000000000000000) == 0);
     assert(len);
 
-    if (av_new_packet(packet, len)) {
+    // a data packet following config packets is received right after them
+    uint32_t prefix = (pts != NO_PTS && stream->has_pending) ? stream->pending.size : 0;
+    if (!stream->packet_pool.NewPacket(packet, prefix + len)) {
         LOGE("Could not allocate packet");
         return false;
     }
+    if (prefix) {
+        memcpy(packet->data, stream->pending.data, prefix);
+    }
 
-    r = net_recv_all(stream->socket, packet->data, len);
+    r = net_recv_all(stream->socket, packet->data + prefix, len);
     if (r < 0 || ((uint32_t) r) < len) {
         av_packet_unref(packet);
         return false;
@@ -65,10 +75,8 @@ stream_recv_packet(Stream* stream, AVPacket *packet) {
 }
 
 static void
-notify_stopped(void) {
-    SDL_Event stop_event;
-    stop_event.type = EVENT_STREAM_STOPPED;
-    SDL_PushEvent(&stop_event);
+notify_stopped(Stream* stream) {
+    push_owned_event(EVENT_STREAM_STOPPED, stream->event_owner);
 }
 
 static bool
@@ -82,7 +90,7 @@ process_config_packet(Stream* stream, AVPacket* packet) {
 
 static bool
 process_frame(Stream* stream, AVPacket *packet) {
-    if (stream->decoder && !stream->decoder->Push(packet)) {
+    if (stream->decoder && !stream->decoder->Push(packet, stream->recv_time_us)) {
         return false;
     }
 
@@ -132,32 +140,23 @@ stream_push_packet(Stream* stream, AVPacket *packet) {
 
     // A config packet must not be decoded immetiately (it contains no
     // frame); instead, it must be concatenated with the future data packet.
-    if (stream->has_pending || is_config) {
-        size_t offset;
+    // The data packet already starts with the pending config packets (see
+    // stream_recv_packet()), only consecutive config packets are merged here.
+    if (is_config) {
         if (stream->has_pending) {
-            offset = stream->pending.size;
+            size_t offset = stream->pending.size;
             if (av_grow_packet(&stream->pending, packet->size)) {
                 LOGE("Could not grow packet");
                 return false;
             }
+            memcpy(stream->pending.data + offset, packet->data, packet->size);
         } else {
-            offset = 0;
-            if (av_new_packet(&stream->pending, packet->size)) {
+            if (av_packet_ref(&stream->pending, packet)) {
                 LOGE("Could not create packet");
                 return false;
             }
             stream->has_pending = true;
         }
-
-        memcpy(stream->pending.data + offset, packet->data, packet->size);
-
-        if (!is_config) {
-            // prepare the concat packet to send to the decoder
-            stream->pending.pts = packet->pts;
-            stream->pending.dts = packet->dts;
-            stream->pending.flags = packet->flags;
-            packet = &stream->pending;
-        }
     }
 
     if (is_config) {
@@ -243,6 +242,8 @@ run_stream(void *data) {
     }
 
     LOGD("End of frames");
+    LOGI("Packets: %" PRIu64_ ", pool hits %" PRIu64_,
+        (uint64_t)stream->packet_pool.nr_packets, stream->packet_pool.GetHits());
 
     if (stream->has_pending) {
         av_packet_unref(&stream->pending);
@@ -266,12 +267,12 @@ finally_close_decoder:
 finally_free_codec_ctx:
     avcodec_free_context(&stream->codec_ctx);
 end:
-    notify_stopped();
+    notify_stopped(stream);
     return 0;
 }
 
 Stream::Stream(socket_t socket, Decoder* decoder, Recorder* recorder)
-    : socket(socket), decoder(decoder), recorder(recorder), has_pending(false)
+    : socket(socket), decoder(decoder), recorder(recorder), has_pending(false), recv_time_us(0), event_owner(NULL)
 {
 }
 
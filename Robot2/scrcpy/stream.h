@@ -10,6 +10,7 @@ extern "C" {
 #include <SDL2/SDL_thread.h>
 
 #include "config.h"
+#include "util/packet_pool.h"
 
 class Decoder; class Recorder;
 
@@ -23,8 +24,13 @@ public:
     AVCodecParserContext *parser;
     // successive packets may need to be concatenated, until a non-config
     // packet is available
+    // the config packets are copied in front of the next data packet while
+    // it is received, so the frame data is never copied
     bool has_pending;
     AVPacket pending;
+    PacketPool packet_pool;
+    int64_t recv_time_us; // header arrival of the last data packet (LatencyTrace::NowUs)
+    void* event_owner; // data1 of the pushed events, see EventRouter
 
     Stream(socket_t socket, Decoder* decoder, Recorder* recorder);
     bool Start();
@@ -0,0 +1,122 @@
+#include "texture_upload.h"
+
+#include <algorithm>
+#include <cstring>
+#include "util/log.h"
+
+TextureUploader::TextureUploader() : pbo{0, 0}, pbo_index(0), pbo_size(0),
+    frame_size{.width = 0, .height = 0}, channels(0), upload_bands(false),
+    nr_uploaded_rows(0), nr_rows(0)
+{
+}
+
+bool TextureUploader::Init(struct size frame_size, int channels)
+{
+    this->frame_size = frame_size;
+    this->channels = channels;
+    this->band_hashes.clear();
+    this->pbo_size = (size_t)channels * frame_size.width * frame_size.height;
+
+    if (!this->pbo[0]) {
+        glGenBuffers(2, this->pbo);
+    }
+    for (GLuint buffer : this->pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, this->pbo_size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR) {
+        LOGW("Could not allocate pixel buffers, uploading synchronously");
+        this->Destroy();
+        return false;
+    }
+    return true;
+}
+
+void TextureUploader::Destroy()
+{
+    if (this->pbo[0]) {
+        glDeleteBuffers(2, this->pbo);
+        this->pbo[0] = this->pbo[1] = 0;
+    }
+    this->band_hashes.clear();
+}
+
+static uint64_t
+hash_rows(const uint8_t* data, size_t size) {
+    // 64-bit multiply-xorshift over 8 byte words, enough to detect changes
+    uint64_t hash = size * 0x9E3779B97F4A7C15ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 0xC4CEB9FE1A85EC53ULL;
+    }
+    return hash;
+}
+
+bool TextureUploader::Upload(const uint8_t* pixels, GLenum format)
+{
+    const size_t stride = (size_t)this->channels * this->frame_size.width;
+    int first_row = 0;
+    int last_row = this->frame_size.height; // exclusive
+
+    if (this->upload_bands) {
+        int nr_bands = (this->frame_size.height + TEXTURE_UPLOAD_BAND_ROWS - 1) / TEXTURE_UPLOAD_BAND_ROWS;
+        bool known = (int)this->band_hashes.size() == nr_bands;
+        if (!known) {
+            this->band_hashes.assign(nr_bands, 0);
+        }
+        int first_band = nr_bands;
+        int last_band = -1;
+        for (int band = 0; band < nr_bands; band++) {
+            int row = band * TEXTURE_UPLOAD_BAND_ROWS;
+            int rows = std::min(TEXTURE_UPLOAD_BAND_ROWS, (int)this->frame_size.height - row);
+            uint64_t hash = hash_rows(pixels + row * stride, rows * stride);
+            if (!known || hash != this->band_hashes[band]) {
+                this->band_hashes[band] = hash;
+                first_band = std::min(first_band, band);
+                last_band = band;
+            }
+        }
+        this->nr_rows += this->frame_size.height;
+        if (last_band < 0) {
+            return false; // unchanged
+        }
+        first_row = first_band * TEXTURE_UPLOAD_BAND_ROWS;
+        last_row = std::min((last_band + 1) * TEXTURE_UPLOAD_BAND_ROWS, (int)this->frame_size.height);
+        this->nr_uploaded_rows += last_row - first_row;
+    }
+
+    const uint8_t* src = pixels + first_row * stride;
+    size_t size = (last_row - first_row) * stride;
+    if (!this->pbo[0]) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, this->frame_size.width,
+            last_row - first_row, format, GL_UNSIGNED_BYTE, src);
+        return true;
+    }
+
+    this->pbo_index ^= 1;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo[this->pbo_index]);
+    // orphan the previous storage, so mapping never waits for a pending copy
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, this->pbo_size, NULL, GL_STREAM_DRAW);
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst) {
+        memcpy(dst, src, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        // the offset into the bound buffer replaces the client pointer
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, this->frame_size.width,
+            last_row - first_row, format, GL_UNSIGNED_BYTE, (const void*)0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!dst) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, this->frame_size.width,
+            last_row - first_row, format, GL_UNSIGNED_BYTE, src);
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+
+#include "common.h"
+
+// rows hashed and uploaded together when only the changed bands are uploaded
+#define TEXTURE_UPLOAD_BAND_ROWS 32
+
+// Streams frames into a texture through two pixel buffer objects used
+// alternately: the driver copies one to the texture asynchronously while the
+// next frame is written into the other, instead of glTexSubImage2D blocking
+// on client memory.
+// With upload_bands, the rows are hashed in bands and only the range between
+// the first and the last changed band is copied.
+// Every method must be called with the GL context current.
+class TextureUploader {
+public:
+    GLuint pbo[2];
+    unsigned pbo_index;
+    size_t pbo_size;
+    struct size frame_size;
+    int channels;
+    bool upload_bands;
+    std::vector<uint64_t> band_hashes; // empty if the texture content is unknown
+    uint64_t nr_uploaded_rows; // statistics of the band uploads
+    uint64_t nr_rows;
+
+    TextureUploader();
+
+    // (re)allocate the buffers for a new frame size, the next upload is full
+    bool Init(struct size frame_size, int channels);
+    void Destroy();
+
+    // upload pixels (tightly packed rows) into the bound texture
+    // return false if nothing changed since the previous upload
+    bool Upload(const uint8_t* pixels, GLenum format);
+};
+
+#endif
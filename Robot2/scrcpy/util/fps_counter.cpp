@@ -6,6 +6,7 @@ extern "C" {
 #include <SDL2/SDL_timer.h>
 }
 #include <cassert>
+#include <cstdio>
 
 #define FPS_COUNTER_INTERVAL_MS 1000
 
@@ -23,6 +24,10 @@ FrameCounter::FrameCounter() : started(false)
     }
 
     this->thread = NULL;
+    this->decoder_mode[0] = '\0';
+    this->packet_pool = NULL;
+    this->last_nr_packets = 0;
+    this->last_nr_allocated = 0;
     //atomic_init(&this->started, 0);
     // no need to initialize the other fields, they are unused until started
 }
@@ -48,6 +53,28 @@ void FrameCounter::DisplayFps() {
     else {
         LOGI("%u fps", rendered_per_second);
     }
+    if (this->nr_decoded) {
+        unsigned decoded_per_second = this->nr_decoded * 1000 / FPS_COUNTER_INTERVAL_MS;
+        LOGI("decode: %u fps, latency avg %.1f ms, max %.1f ms (%s)", decoded_per_second,
+            this->decode_latency_sum_us / 1000.0 / this->nr_decoded,
+            this->decode_latency_max_us / 1000.0,
+            this->decoder_mode[0] ? this->decoder_mode : "default");
+    }
+    if (this->nr_presented) {
+        LOGI("present: %u fps", this->nr_presented * 1000 / FPS_COUNTER_INTERVAL_MS);
+    }
+    if (this->packet_pool) {
+        uint64_t nr_packets = this->packet_pool->nr_packets;
+        uint64_t nr_allocated = this->packet_pool->nr_allocated;
+        unsigned packets = (unsigned)(nr_packets - this->last_nr_packets);
+        unsigned allocated = (unsigned)(nr_allocated - this->last_nr_allocated);
+        if (packets) {
+            LOGI("packets: %u, pool hits %u (%u allocated)", packets,
+                packets - allocated, allocated);
+        }
+        this->last_nr_packets = nr_packets;
+        this->last_nr_allocated = nr_allocated;
+    }
 }
 
 // must be called with mutex locked
@@ -59,6 +86,10 @@ void FrameCounter::CheckIntervalExpired(uint32_t now) {
     this->DisplayFps();
     this->nr_rendered = 0;
     this->nr_skipped = 0;
+    this->nr_decoded = 0;
+    this->nr_presented = 0;
+    this->decode_latency_sum_us = 0;
+    this->decode_latency_max_us = 0;
     // add a multiple of the interval
     uint32_t elapsed_slices =
         (now - this->next_timestamp) / FPS_COUNTER_INTERVAL_MS + 1;
@@ -94,6 +125,10 @@ bool FrameCounter::Start()
     this->next_timestamp = SDL_GetTicks() + FPS_COUNTER_INTERVAL_MS;
     this->nr_rendered = 0;
     this->nr_skipped = 0;
+    this->nr_decoded = 0;
+    this->nr_presented = 0;
+    this->decode_latency_sum_us = 0;
+    this->decode_latency_max_us = 0;
     mutex_unlock(this->mutex);
 
     this->SetStarted(true);
@@ -169,3 +204,40 @@ void FrameCounter::AddSkippedFrame()
     ++this->nr_skipped;
     mutex_unlock(this->mutex);
 }
+
+void FrameCounter::AddDecodedFrame(uint32_t latency_us)
+{
+    if (!this->IsStarted()) {
+        return;
+    }
+
+    mutex_lock(this->mutex);
+    uint32_t now = SDL_GetTicks();
+    this->CheckIntervalExpired(now);
+    ++this->nr_decoded;
+    this->decode_latency_sum_us += latency_us;
+    if (latency_us > this->decode_latency_max_us) {
+        this->decode_latency_max_us = latency_us;
+    }
+    mutex_unlock(this->mutex);
+}
+
+void FrameCounter::AddPresentedFrame()
+{
+    if (!this->IsStarted()) {
+        return;
+    }
+
+    mutex_lock(this->mutex);
+    uint32_t now = SDL_GetTicks();
+    this->CheckIntervalExpired(now);
+    ++this->nr_presented;
+    mutex_unlock(this->mutex);
+}
+
+void FrameCounter::SetDecoderMode(const char* mode)
+{
+    mutex_lock(this->mutex);
+    snprintf(this->decoder_mode, sizeof(this->decoder_mode), "%s", mode);
+    mutex_unlock(this->mutex);
+}
@@ -9,6 +9,7 @@ extern "C" {
 }
 
 #include "../config.h"
+#include "packet_pool.h"
 
 class FrameCounter {
 public:
@@ -24,6 +25,14 @@ public:
     bool interrupted;
     unsigned nr_rendered;
     unsigned nr_skipped;
+    unsigned nr_decoded;
+    unsigned nr_presented; // window swaps, independent of the frame rate
+    uint64_t decode_latency_sum_us;
+    uint32_t decode_latency_max_us;
+    char decoder_mode[64]; // copy of Decoder::GetModeName, empty = default
+    const PacketPool* packet_pool; // set before the stream starts
+    uint64_t last_nr_packets;
+    uint64_t last_nr_allocated;
     uint32_t next_timestamp;
 
     FrameCounter();
@@ -39,6 +48,9 @@ public:
     void Join();
     void AddRenderedFrame();
     void AddSkippedFrame();
+    void AddDecodedFrame(uint32_t latency_us);
+    void AddPresentedFrame();
+    void SetDecoderMode(const char* mode);
 
     void SetStarted(bool started);
     void CheckIntervalExpired(uint32_t now);
@@ -0,0 +1,64 @@
+#include "packet_pool.h"
+#include <string.h>
+#include "log.h"
+
+#if LIBAVUTIL_VERSION_MAJOR < 57
+typedef int pool_size_t;
+#else
+typedef size_t pool_size_t;
+#endif
+
+static AVBufferRef* pool_alloc(void* opaque, pool_size_t size) {
+    PacketPool* pool = (PacketPool*)opaque;
+    pool->nr_allocated++;
+    return av_buffer_alloc(size);
+}
+
+PacketPool::PacketPool() : nr_packets(0), nr_allocated(0)
+{
+    for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        this->pools[i] = NULL; // created on first use
+    }
+}
+
+PacketPool::~PacketPool()
+{
+    // the pools are freed once their last buffer is released
+    for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+        av_buffer_pool_uninit(&this->pools[i]);
+    }
+}
+
+bool PacketPool::NewPacket(AVPacket* packet, int size)
+{
+    av_init_packet(packet);
+    this->nr_packets++;
+
+    size_t padded = (size_t)size + AV_INPUT_BUFFER_PADDING_SIZE;
+    int cls = 0;
+    while (cls < PACKET_POOL_CLASSES && ((size_t)1 << (PACKET_POOL_MIN_SHIFT + cls)) < padded) {
+        cls++;
+    }
+    if (cls == PACKET_POOL_CLASSES) {
+        // larger than any size class, not worth keeping around
+        this->nr_allocated++;
+        return !av_new_packet(packet, size);
+    }
+
+    if (!this->pools[cls]) {
+        this->pools[cls] = av_buffer_pool_init2((pool_size_t)1 << (PACKET_POOL_MIN_SHIFT + cls),
+            this, pool_alloc, NULL);
+        if (!this->pools[cls]) {
+            LOGE("Could not create packet pool");
+            return false;
+        }
+    }
+    packet->buf = av_buffer_pool_get(this->pools[cls]);
+    if (!packet->buf) {
+        return false;
+    }
+    packet->data = packet->buf->data;
+    packet->size = size;
+    memset(packet->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    return true;
+}
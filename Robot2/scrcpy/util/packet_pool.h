@@ -0,0 +1,37 @@
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <atomic>
+#include <stdint.h>
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+}
+
+// smallest and largest pooled buffer size (power of two size classes)
+#define PACKET_POOL_MIN_SHIFT 12 // 4 KiB
+#define PACKET_POOL_MAX_SHIFT 23 // 8 MiB
+#define PACKET_POOL_CLASSES (PACKET_POOL_MAX_SHIFT - PACKET_POOL_MIN_SHIFT + 1)
+
+// Recycles the packet buffers of the stream thread: a packet gets a buffer
+// of the smallest size class which fits it, the buffer returns to its pool
+// when the last reference of the packet is released (also on the decoder or
+// recorder thread).
+class PacketPool {
+public:
+    AVBufferPool* pools[PACKET_POOL_CLASSES];
+
+    // number of packets allocated, and the ones which needed a new buffer
+    std::atomic<uint64_t> nr_packets;
+    std::atomic<uint64_t> nr_allocated;
+
+    PacketPool();
+    ~PacketPool();
+
+    // like av_new_packet(), but with a pooled (padded) buffer
+    bool NewPacket(AVPacket* packet, int size);
+
+    uint64_t GetHits() const { return this->nr_packets - this->nr_allocated; }
+};
+
+#endif
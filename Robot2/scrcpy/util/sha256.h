@@ -0,0 +1,17 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_HEX_LENGTH 64
+
+// write the SHA-256 digest of data as 64 lowercase hex chars and a nul byte
+void
+sha256_hex(const uint8_t* data, size_t len, char hex[SHA256_HEX_LENGTH + 1]);
+
+// digest of a file, false if it could not be read
+bool
+sha256_file_hex(const char* path, char hex[SHA256_HEX_LENGTH + 1]);
+
+#endif
@@ -0,0 +1,26 @@
+#include "startup_timer.h"
+
+#include "log.h"
+#include "../../LatencyTrace.h"
+
+StartupTimer::StartupTimer() {
+    this->Restart();
+}
+
+void StartupTimer::Restart() {
+    this->phases.clear();
+    this->start_us = this->last_us = LatencyTrace::NowUs();
+}
+
+void StartupTimer::Mark(const char* name) {
+    int64_t now_us = LatencyTrace::NowUs();
+    this->phases.push_back({name, now_us - this->last_us});
+    this->last_us = now_us;
+}
+
+void StartupTimer::Print() const {
+    LOGI("Startup took %.1f ms:", (this->last_us - this->start_us) / 1000.0);
+    for (const struct phase& phase : this->phases) {
+        LOGI("    %-16s %8.1f ms", phase.name, phase.duration_us / 1000.0);
+    }
+}
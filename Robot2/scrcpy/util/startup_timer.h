@@ -0,0 +1,26 @@
+#ifndef STARTUP_TIMER_H
+#define STARTUP_TIMER_H
+
+#include <stdint.h>
+#include <vector>
+
+// Duration of the startup phases of a session, from the server push to the
+// first frame. The phases are marked on the thread running the session.
+class StartupTimer {
+public:
+    struct phase {
+        const char* name;
+        int64_t duration_us;
+    };
+    std::vector<struct phase> phases;
+    int64_t start_us;
+    int64_t last_us;
+
+    StartupTimer();
+    void Restart();
+    // end of a phase, which started at the previous mark
+    void Mark(const char* name);
+    void Print() const;
+};
+
+#endif
@@ -0,0 +1,344 @@
+#include "yuv_convert.h"
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+#include <opencv2/core/utility.hpp>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define YUV_TARGET_SSE41
+#define YUV_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define YUV_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define YUV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Fixed point BT.601 limited range coefficients with 6 fractional bits, small
+// enough for 16 bit lanes:
+//   R = 1.164 (Y - 16) + 1.596 (V - 128)
+//   G = 1.164 (Y - 16) - 0.391 (U - 128) - 0.813 (V - 128)
+//   B = 1.164 (Y - 16) + 2.018 (U - 128)
+// Only the blue sum can leave the int16 range, and only above 255, so the
+// saturating SIMD adds give the same result as the clamped scalar code.
+#define YUV_SHIFT 6
+#define YUV_Y 74
+#define YUV_RV 102
+#define YUV_GU 25
+#define YUV_GV 52
+#define YUV_BU 129
+
+// minimal row band height for the parallel conversion
+#define YUV_BAND_MIN_ROWS 64
+
+int sc_frame_format_channels(enum sc_frame_format format) {
+    return format == SC_FRAME_FORMAT_BGRA ? 4 : 1;
+}
+
+enum sc_frame_format sc_frame_format_from_channel(const char* channel) {
+    if (!strcmp(channel, "Grayscale") || !strcmp(channel, "grayscale")) {
+        return SC_FRAME_FORMAT_GRAY;
+    }
+    if (!strcmp(channel, "R")) return SC_FRAME_FORMAT_R;
+    if (!strcmp(channel, "G")) return SC_FRAME_FORMAT_G;
+    if (!strcmp(channel, "B")) return SC_FRAME_FORMAT_B;
+    return SC_FRAME_FORMAT_BGRA;
+}
+
+const char* sc_frame_format_name(enum sc_frame_format format) {
+    switch (format) {
+    case SC_FRAME_FORMAT_GRAY: return "Grayscale";
+    case SC_FRAME_FORMAT_R: return "R";
+    case SC_FRAME_FORMAT_G: return "G";
+    case SC_FRAME_FORMAT_B: return "B";
+    default: return "BGRA";
+    }
+}
+
+static void cpuid(int regs[4], int leaf, int subleaf) {
+#ifdef _MSC_VER
+    __cpuidex(regs, leaf, subleaf);
+#else
+    unsigned a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    regs[0] = a; regs[1] = b; regs[2] = c; regs[3] = d;
+#endif
+}
+
+static uint64_t xgetbv0(void) {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+enum sc_simd_level yuv_convert_detect_simd(void) {
+    static const enum sc_simd_level level = []() {
+        int regs[4];
+        cpuid(regs, 0, 0);
+        int max_leaf = regs[0];
+        cpuid(regs, 1, 0);
+        bool sse41 = regs[2] & (1 << 19);
+        bool osxsave = regs[2] & (1 << 27);
+        bool avx = regs[2] & (1 << 28);
+        bool avx2 = false;
+        // AVX2 also needs the OS to save the YMM registers
+        if (max_leaf >= 7 && osxsave && avx && (xgetbv0() & 6) == 6) {
+            cpuid(regs, 7, 0);
+            avx2 = regs[1] & (1 << 5);
+        }
+        return avx2 ? SC_SIMD_AVX2 : sse41 ? SC_SIMD_SSE41 : SC_SIMD_NONE;
+    }();
+    return level;
+}
+
+const char* yuv_convert_simd_name(enum sc_simd_level simd) {
+    switch (simd) {
+    case SC_SIMD_SSE41: return "SSE4.1";
+    case SC_SIMD_AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+static inline uint8_t clamp_shift(int value) {
+    value >>= YUV_SHIFT;
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// Converts the pixels [x, width) of a row.
+template<enum sc_frame_format F>
+static void convert_row_scalar(const uint8_t* y_row, const uint8_t* u_row,
+    const uint8_t* v_row, uint8_t* out, int x, int width) {
+    const int channels = F == SC_FRAME_FORMAT_BGRA ? 4 : 1;
+    out += x * channels;
+    for (; x < width; x++, out += channels) {
+        int yt = (y_row[x] - 16) * YUV_Y + (1 << (YUV_SHIFT - 1));
+        int d = u_row[x >> 1] - 128;
+        int e = v_row[x >> 1] - 128;
+        if constexpr (F == SC_FRAME_FORMAT_BGRA) {
+            out[0] = clamp_shift(yt + YUV_BU * d);
+            out[1] = clamp_shift(yt - YUV_GU * d - YUV_GV * e);
+            out[2] = clamp_shift(yt + YUV_RV * e);
+            out[3] = 255;
+        } else if constexpr (F == SC_FRAME_FORMAT_GRAY) {
+            out[0] = clamp_shift(yt);
+        } else if constexpr (F == SC_FRAME_FORMAT_R) {
+            out[0] = clamp_shift(yt + YUV_RV * e);
+        } else if constexpr (F == SC_FRAME_FORMAT_G) {
+            out[0] = clamp_shift(yt - YUV_GU * d - YUV_GV * e);
+        } else {
+            out[0] = clamp_shift(yt + YUV_BU * d);
+        }
+    }
+}
+
+// 8 pixels of 16 bit y, d (U - 128) and e (V - 128) lanes.
+template<enum sc_frame_format F>
+YUV_TARGET_SSE41 static inline void compute_sse41(__m128i y, __m128i d, __m128i e,
+    __m128i* r, __m128i* g, __m128i* b) {
+    __m128i yt = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)),
+        _mm_set1_epi16(YUV_Y)), _mm_set1_epi16(1 << (YUV_SHIFT - 1)));
+    if constexpr (F == SC_FRAME_FORMAT_BGRA || F == SC_FRAME_FORMAT_R) {
+        *r = _mm_srai_epi16(_mm_adds_epi16(yt, _mm_mullo_epi16(e, _mm_set1_epi16(YUV_RV))), YUV_SHIFT);
+    }
+    if constexpr (F == SC_FRAME_FORMAT_BGRA || F == SC_FRAME_FORMAT_G) {
+        *g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(yt, _mm_mullo_epi16(d, _mm_set1_epi16(YUV_GU))),
+            _mm_mullo_epi16(e, _mm_set1_epi16(YUV_GV))), YUV_SHIFT);
+    }
+    if constexpr (F == SC_FRAME_FORMAT_BGRA || F == SC_FRAME_FORMAT_B) {
+        *b = _mm_srai_epi16(_mm_adds_epi16(yt, _mm_mullo_epi16(d, _mm_set1_epi16(YUV_BU))), YUV_SHIFT);
+    }
+    if constexpr (F == SC_FRAME_FORMAT_GRAY) {
+        *r = _mm_srai_epi16(yt, YUV_SHIFT);
+    }
+}
+
+template<enum sc_frame_format F>
+YUV_TARGET_SSE41 static int convert_row_sse41(const uint8_t* y_row, const uint8_t* u_row,
+    const uint8_t* v_row, uint8_t* out, int width) {
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i y8 = _mm_loadu_si128((const __m128i*)(y_row + x));
+        __m128i y_lo = _mm_cvtepu8_epi16(y8);
+        __m128i y_hi = _mm_cvtepu8_epi16(_mm_srli_si128(y8, 8));
+        __m128i d_lo = c128, d_hi = c128, e_lo = c128, e_hi = c128;
+        if constexpr (F != SC_FRAME_FORMAT_GRAY) {
+            __m128i d = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(u_row + x / 2))), c128);
+            __m128i e = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(v_row + x / 2))), c128);
+            d_lo = _mm_unpacklo_epi16(d, d); d_hi = _mm_unpackhi_epi16(d, d);
+            e_lo = _mm_unpacklo_epi16(e, e); e_hi = _mm_unpackhi_epi16(e, e);
+        }
+        __m128i r_lo = _mm_setzero_si128(), g_lo = r_lo, b_lo = r_lo, r_hi = r_lo, g_hi = r_lo, b_hi = r_lo;
+        compute_sse41<F>(y_lo, d_lo, e_lo, &r_lo, &g_lo, &b_lo);
+        compute_sse41<F>(y_hi, d_hi, e_hi, &r_hi, &g_hi, &b_hi);
+        if constexpr (F == SC_FRAME_FORMAT_BGRA) {
+            __m128i r = _mm_packus_epi16(r_lo, r_hi);
+            __m128i g = _mm_packus_epi16(g_lo, g_hi);
+            __m128i b = _mm_packus_epi16(b_lo, b_hi);
+            __m128i bg_lo = _mm_unpacklo_epi8(b, g), bg_hi = _mm_unpackhi_epi8(b, g);
+            __m128i ra_lo = _mm_unpacklo_epi8(r, alpha), ra_hi = _mm_unpackhi_epi8(r, alpha);
+            __m128i* dst = (__m128i*)(out + 4 * x);
+            _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(bg_lo, ra_lo));
+            _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(bg_lo, ra_lo));
+            _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(bg_hi, ra_hi));
+            _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(bg_hi, ra_hi));
+        } else {
+            __m128i c = F == SC_FRAME_FORMAT_G ? _mm_packus_epi16(g_lo, g_hi)
+                : F == SC_FRAME_FORMAT_B ? _mm_packus_epi16(b_lo, b_hi)
+                : _mm_packus_epi16(r_lo, r_hi);
+            _mm_storeu_si128((__m128i*)(out + x), c);
+        }
+    }
+    return x;
+}
+
+template<enum sc_frame_format F>
+YUV_TARGET_AVX2 static inline void compute_avx2(__m256i y, __m256i d, __m256i e,
+    __m256i* r, __m256i* g, __m256i* b) {
+    __m256i yt = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)),
+        _mm256_set1_epi16(YUV_Y)), _mm256_set1_epi16(1 << (YUV_SHIFT - 1)));
+    if constexpr (F == SC_FRAME_FORMAT_BGRA || F == SC_FRAME_FORMAT_R) {
+        *r = _mm256_srai_epi16(_mm256_adds_epi16(yt, _mm256_mullo_epi16(e, _mm256_set1_epi16(YUV_RV))), YUV_SHIFT);
+    }
+    if constexpr (F == SC_FRAME_FORMAT_BGRA || F == SC_FRAME_FORMAT_G) {
+        *g = _mm256_srai_epi16(_mm256_subs_epi16(_mm256_subs_epi16(yt, _mm256_mullo_epi16(d, _mm256_set1_epi16(YUV_GU))),
+            _mm256_mullo_epi16(e, _mm256_set1_epi16(YUV_GV))), YUV_SHIFT);
+    }
+    if constexpr (F == SC_FRAME_FORMAT_BGRA || F == SC_FRAME_FORMAT_B) {
+        *b = _mm256_srai_epi16(_mm256_adds_epi16(yt, _mm256_mullo_epi16(d, _mm256_set1_epi16(YUV_BU))), YUV_SHIFT);
+    }
+    if constexpr (F == SC_FRAME_FORMAT_GRAY) {
+        *r = _mm256_srai_epi16(yt, YUV_SHIFT);
+    }
+}
+
+template<enum sc_frame_format F>
+YUV_TARGET_AVX2 static int convert_row_avx2(const uint8_t* y_row, const uint8_t* u_row,
+    const uint8_t* v_row, uint8_t* out, int width) {
+    const __m256i c128 = _mm256_set1_epi16(128);
+    const __m256i alpha = _mm256_set1_epi8((char)0xff);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i y_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(y_row + x)));
+        __m256i y_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(y_row + x + 16)));
+        __m256i d_lo = c128, d_hi = c128, e_lo = c128, e_hi = c128;
+        if constexpr (F != SC_FRAME_FORMAT_GRAY) {
+            // duplicate every chroma sample for the 2 pixels it covers
+            __m128i u = _mm_loadu_si128((const __m128i*)(u_row + x / 2));
+            __m128i v = _mm_loadu_si128((const __m128i*)(v_row + x / 2));
+            d_lo = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u, u)), c128);
+            d_hi = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpackhi_epi8(u, u)), c128);
+            e_lo = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v, v)), c128);
+            e_hi = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpackhi_epi8(v, v)), c128);
+        }
+        __m256i r_lo = _mm256_setzero_si256(), g_lo = r_lo, b_lo = r_lo, r_hi = r_lo, g_hi = r_lo, b_hi = r_lo;
+        compute_avx2<F>(y_lo, d_lo, e_lo, &r_lo, &g_lo, &b_lo);
+        compute_avx2<F>(y_hi, d_hi, e_hi, &r_hi, &g_hi, &b_hi);
+        // packus works per 128 bit lane: lane 0 holds pixels 0-7 and 16-23,
+        // lane 1 holds pixels 8-15 and 24-31
+        if constexpr (F == SC_FRAME_FORMAT_BGRA) {
+            __m256i r = _mm256_packus_epi16(r_lo, r_hi);
+            __m256i g = _mm256_packus_epi16(g_lo, g_hi);
+            __m256i b = _mm256_packus_epi16(b_lo, b_hi);
+            __m256i bg_lo = _mm256_unpacklo_epi8(b, g), bg_hi = _mm256_unpackhi_epi8(b, g);
+            __m256i ra_lo = _mm256_unpacklo_epi8(r, alpha), ra_hi = _mm256_unpackhi_epi8(r, alpha);
+            __m256i p0 = _mm256_unpacklo_epi16(bg_lo, ra_lo); // 0-3, 8-11
+            __m256i p1 = _mm256_unpackhi_epi16(bg_lo, ra_lo); // 4-7, 12-15
+            __m256i p2 = _mm256_unpacklo_epi16(bg_hi, ra_hi); // 16-19, 24-27
+            __m256i p3 = _mm256_unpackhi_epi16(bg_hi, ra_hi); // 20-23, 28-31
+            __m256i* dst = (__m256i*)(out + 4 * x);
+            _mm256_storeu_si256(dst + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+            _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(p0, p1, 0x31));
+            _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(p2, p3, 0x20));
+            _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+        } else {
+            __m256i c = F == SC_FRAME_FORMAT_G ? _mm256_packus_epi16(g_lo, g_hi)
+                : F == SC_FRAME_FORMAT_B ? _mm256_packus_epi16(b_lo, b_hi)
+                : _mm256_packus_epi16(r_lo, r_hi);
+            _mm256_storeu_si256((__m256i*)(out + x), _mm256_permute4x64_epi64(c, 0xD8));
+        }
+    }
+    return x;
+}
+
+template<enum sc_frame_format F>
+static void convert_rows(const uint8_t* const data[3], const int linesize[3],
+    int width, int row_begin, int row_end, uint8_t* dst, int dst_stride,
+    enum sc_simd_level simd) {
+    for (int row = row_begin; row < row_end; row++) {
+        const uint8_t* y_row = data[0] + (ptrdiff_t)row * linesize[0];
+        const uint8_t* u_row = data[1] + (ptrdiff_t)(row >> 1) * linesize[1];
+        const uint8_t* v_row = data[2] + (ptrdiff_t)(row >> 1) * linesize[2];
+        uint8_t* out = dst + (ptrdiff_t)row * dst_stride;
+        int x = 0;
+        if (simd == SC_SIMD_AVX2) {
+            x = convert_row_avx2<F>(y_row, u_row, v_row, out, width);
+        } else if (simd == SC_SIMD_SSE41) {
+            x = convert_row_sse41<F>(y_row, u_row, v_row, out, width);
+        }
+        convert_row_scalar<F>(y_row, u_row, v_row, out, x, width);
+    }
+}
+
+template<enum sc_frame_format F>
+static void convert(const uint8_t* const data[3], const int linesize[3],
+    int width, int height, uint8_t* dst, int dst_stride,
+    enum sc_simd_level simd, bool parallel) {
+    int bands = parallel ? std::min(cv::getNumThreads(), height / YUV_BAND_MIN_ROWS) : 1;
+    if (bands <= 1) {
+        convert_rows<F>(data, linesize, width, 0, height, dst, dst_stride, simd);
+        return;
+    }
+    // even band heights, so that a chroma row is read by a single band
+    int band_rows = ((height + bands - 1) / bands + 1) & ~1;
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+        for (int band = range.start; band < range.end; band++) {
+            int row_begin = band * band_rows;
+            int row_end = std::min(height, row_begin + band_rows);
+            if (row_begin < row_end) {
+                convert_rows<F>(data, linesize, width, row_begin, row_end, dst, dst_stride, simd);
+            }
+        }
+    });
+}
+
+void yuv420p_convert_planes(const uint8_t* const data[3], const int linesize[3],
+    int width, int height, uint8_t* dst, int dst_stride,
+    enum sc_frame_format format, enum sc_simd_level simd, bool parallel) {
+    // never use a level the CPU does not support
+    simd = std::min(simd, yuv_convert_detect_simd());
+    switch (format) {
+    case SC_FRAME_FORMAT_GRAY:
+        convert<SC_FRAME_FORMAT_GRAY>(data, linesize, width, height, dst, dst_stride, simd, parallel);
+        break;
+    case SC_FRAME_FORMAT_R:
+        convert<SC_FRAME_FORMAT_R>(data, linesize, width, height, dst, dst_stride, simd, parallel);
+        break;
+    case SC_FRAME_FORMAT_G:
+        convert<SC_FRAME_FORMAT_G>(data, linesize, width, height, dst, dst_stride, simd, parallel);
+        break;
+    case SC_FRAME_FORMAT_B:
+        convert<SC_FRAME_FORMAT_B>(data, linesize, width, height, dst, dst_stride, simd, parallel);
+        break;
+    default:
+        convert<SC_FRAME_FORMAT_BGRA>(data, linesize, width, height, dst, dst_stride, simd, parallel);
+        break;
+    }
+}
+
+bool yuv420p_convert(const AVFrame* frame, uint8_t* dst,
+    enum sc_frame_format format) {
+    if (frame->format != AV_PIX_FMT_YUV420P) {
+        return false;
+    }
+    yuv420p_convert_planes(frame->data, frame->linesize, frame->width,
+        frame->height, dst, frame->width * sc_frame_format_channels(format),
+        format, yuv_convert_detect_simd(),
+        frame->width * frame->height >= YUV_CONVERT_PARALLEL_MIN_PIXELS);
+    return true;
+}
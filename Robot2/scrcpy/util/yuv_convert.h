@@ -0,0 +1,55 @@
+#ifndef YUV_CONVERT_H
+#define YUV_CONVERT_H
+
+#include <stdint.h>
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// Output of the YUV420P frame conversion.
+// The single channel formats match the detector image channels, so the
+// worker can skip its own preprocessing.
+enum sc_frame_format {
+    SC_FRAME_FORMAT_BGRA,
+    SC_FRAME_FORMAT_GRAY, // luma scaled to full range
+    SC_FRAME_FORMAT_R,
+    SC_FRAME_FORMAT_G,
+    SC_FRAME_FORMAT_B,
+};
+
+enum sc_simd_level {
+    SC_SIMD_NONE,
+    SC_SIMD_SSE41,
+    SC_SIMD_AVX2,
+};
+
+// frames with at least this many pixels are converted in row bands on
+// multiple threads
+#define YUV_CONVERT_PARALLEL_MIN_PIXELS (1280 * 720)
+
+int sc_frame_format_channels(enum sc_frame_format format);
+
+// "Grayscale", "R", "G" or "B" (the image_channel config values), BGRA for
+// anything else
+enum sc_frame_format sc_frame_format_from_channel(const char* channel);
+
+const char* sc_frame_format_name(enum sc_frame_format format);
+
+// best level supported by the CPU (detected once)
+enum sc_simd_level yuv_convert_detect_simd(void);
+
+const char* yuv_convert_simd_name(enum sc_simd_level simd);
+
+// convert a YUV420P image (BT.601, limited range) into dst
+// dst_stride is expressed in bytes
+void yuv420p_convert_planes(const uint8_t* const data[3], const int linesize[3],
+    int width, int height, uint8_t* dst, int dst_stride,
+    enum sc_frame_format format, enum sc_simd_level simd, bool parallel);
+
+// convert a decoded frame with the best SIMD level, the rows of large frames
+// are split between threads
+// return false if the frame is not YUV420P
+bool yuv420p_convert(const AVFrame* frame, uint8_t* dst,
+    enum sc_frame_format format);
+
+#endif
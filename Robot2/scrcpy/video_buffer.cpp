@@ -67,6 +67,7 @@ VideoBuffer::~VideoBuffer()
 
 void VideoBuffer::swap_frames() {
     std::swap(this->decoding_frame, this->rendering_frame);
+    std::swap(this->decoding_timing, this->rendering_timing);
 }
 
 void VideoBuffer::offer_decoded_frame(bool* previous_frame_skipped)
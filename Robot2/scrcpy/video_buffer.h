@@ -6,6 +6,7 @@
 
 #include "config.h"
 #include "util/fps_counter.h"
+#include "../LatencyTrace.h"
 
 // forward declarations
 typedef struct AVFrame AVFrame;
@@ -14,6 +15,9 @@ class VideoBuffer {
 public:
     AVFrame* decoding_frame;
     AVFrame* rendering_frame;
+    // stage timestamps of the frames, swapped with them
+    FrameTiming decoding_timing;
+    FrameTiming rendering_timing;
     SDL_mutex* mutex;
     bool render_expired_frames;
     bool interrupted;